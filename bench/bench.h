@@ -0,0 +1,27 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+
+/* Timing helpers shared by the benchmarks. */
+namespace bench {
+
+/* Keep __val (and what it points to) alive against the optimizer. */
+template <typename _Tp>
+inline void keep(const _Tp &__val) {
+    asm volatile("" : : "r,m"(__val) : "memory");
+}
+
+/* Best wall time of __reps runs of __fn, in seconds. */
+template <typename _Fn>
+inline double best_of(int __reps, _Fn &&__fn) {
+    double __best = 1e300;
+    for (int i = 0 ; i != __reps ; ++i) {
+        const auto __beg = std::chrono::steady_clock::now();
+        __fn();
+        const auto __end = std::chrono::steady_clock::now();
+        __best = std::min(__best, std::chrono::duration <double> (__end - __beg).count());
+    }
+    return __best;
+}
+
+} // namespace bench
@@ -0,0 +1,48 @@
+/**
+ * bit_matrix transpose, product (Four Russians) and elimination
+ * (M4RI) on random square matrices, in seconds per call. Sizes go
+ * from 4K to 64K, or up to the first argument if given; a 64K
+ * matrix is 512 MiB, and the product holds three of them. Each
+ * call runs once past 8K, as a single call takes seconds. The
+ * elimination time includes an O(n^2) copy of the input. A full run
+ * takes about 40 minutes on one core, nearly all of it at 64K.
+ */
+#include "container/bit_matrix.h"
+#include "bench.h"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+using dark::bit_matrix;
+
+static bit_matrix random_matrix(size_t __n, std::mt19937_64 &__rng) {
+    bit_matrix __ret(__n, __n); // __n is a multiple of 64, no padding.
+    for (size_t i = 0 ; i != __n ; ++i) {
+        const auto __row = __ret.row_data(i);
+        for (size_t j = 0 ; j != __ret.row_words() ; ++j) __row[j] = __rng();
+    }
+    return __ret;
+}
+
+static void run(size_t __n) {
+    std::mt19937_64 rng(1);
+    const auto a = random_matrix(__n, rng);
+    const auto b = random_matrix(__n, rng);
+    const int reps = __n <= 8192 ? 3 : 1;
+
+    const auto report = [&](const char *op, double sec) {
+        std::printf("  %6zu  %-10s %10.3f s\n", __n, op, sec);
+    };
+
+    report("transpose", bench::best_of(reps, [&] { bench::keep(a.transpose()); }));
+    report("product",   bench::best_of(reps, [&] { bench::keep(a * b); }));
+    report("eliminate", bench::best_of(reps, [&] {
+        auto c = a;
+        bench::keep(c.eliminate());
+    }));
+}
+
+int main(int argc, char **argv) {
+    const size_t __max = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 65536;
+    for (size_t n = 4096 ; n <= __max ; n *= 2) run(n);
+}
@@ -0,0 +1,54 @@
+/**
+ * GB/s of each bulk bitset kernel, per instruction set.
+ * Bytes are those touched: a binary op reads two arrays and writes
+ * one, not reads and writes one, and the reductions read one.
+ * none() runs on zeros and all() on ones, so neither stops early.
+ */
+#include "container/bitset.h"
+#include "bench.h"
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace dark::__detail::__bitset;
+
+struct isa { const char *name; const kernel_table *table; bool ok; };
+
+static void run(const isa &__isa, size_t __words) {
+    std::mt19937_64 rng(1);
+    std::vector <_Word_t> a(__words), b(__words), zeros(__words, 0), ones(__words, ~_Word_t{0});
+    for (auto &x : a) x = rng();
+    for (auto &x : b) x = rng();
+
+    const auto &k = *__isa.table;
+    const double n = double(__words * sizeof(_Word_t));
+    const int reps = __words < (size_t{1} << 16) ? 2000 : 20;
+    const auto report = [&](const char *op, double bytes, double sec) {
+        std::printf("  %-6s %-6s %8.2f GB/s\n", __isa.name, op, bytes / sec / 1e9);
+    };
+
+    report("and",   3 * n, bench::best_of(reps, [&] { k.do_and(a.data(), b.data(), __words); bench::keep(a.data()); }));
+    report("or",    3 * n, bench::best_of(reps, [&] { k.do_or_(a.data(), b.data(), __words); bench::keep(a.data()); }));
+    report("xor",   3 * n, bench::best_of(reps, [&] { k.do_xor(a.data(), b.data(), __words); bench::keep(a.data()); }));
+    report("flip",  2 * n, bench::best_of(reps, [&] { k.do_not(a.data(), __words); bench::keep(a.data()); }));
+    report("count", 1 * n, bench::best_of(reps, [&] { bench::keep(k.count(a.data(), __words)); }));
+    report("none",  1 * n, bench::best_of(reps, [&] { bench::keep(k.none(zeros.data(), __words)); }));
+    report("all",   1 * n, bench::best_of(reps, [&] { bench::keep(k.all(ones.data(), __words)); }));
+}
+
+int main() {
+    __builtin_cpu_init();
+    const isa isas[] = {
+        { "scalar", &scalar_kernel, true },
+#ifdef _DARK_BITSET_SIMD
+        { "avx2",   &avx2_kernel,   bool(__builtin_cpu_supports("avx2")) },
+        { "avx512", &avx512_kernel, __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq") },
+#endif
+    };
+    /* 128 KiB per array stays in L2; 32 MiB (2^28 bits) goes to memory. */
+    for (const size_t words : { size_t{1} << 14, size_t{1} << 22 }) {
+        std::printf("%zu bits (%zu KiB per array)\n", words * __WBits, words * sizeof(_Word_t) / 1024);
+        for (const auto &i : isas)
+            if (i.ok) run(i, words);
+    }
+}
@@ -0,0 +1,63 @@
+/**
+ * Scaling of bitset_executor with the thread_pool size, in GB/s.
+ * Bytes are counted as in bitset_kernels: or reads two arrays and
+ * writes one, count reads one, fill writes one, and a shift reads
+ * one and writes one (the shift row is a lshift then an rshift).
+ * Pool sizes go 1, 2, 4, ... up to the hardware threads, or up to
+ * the first argument if given. Sizes past the core count show the
+ * cost of oversubscription, not a speedup.
+ */
+#include "container/bitset_parallel.h"
+#include "bench.h"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+
+using dark::dynamic_bitset;
+using dark::bitset_executor;
+using dark::thread_pool;
+
+/* __n is a multiple of 64, so there are no padding bits to clear. */
+static dynamic_bitset random_bits(size_t __n, std::mt19937_64 &__rng) {
+    dynamic_bitset __bits(__n);
+    const auto __data = __bits.word_data();
+    for (size_t i = 0 ; i != __bits.word_count() ; ++i) __data[i] = __rng();
+    return __bits;
+}
+
+static void run(size_t __threads, size_t __bits) {
+    std::mt19937_64 rng(1);
+    auto a = random_bits(__bits, rng);
+    const auto b = random_bits(__bits, rng);
+
+    thread_pool pool(__threads);
+    const bitset_executor exec(pool);
+    const double n = double(__bits / 8);
+    const int reps = 10;
+    const auto report = [&](const char *op, double bytes, double sec) {
+        std::printf("  %3zu  %-6s %8.2f GB/s\n", __threads, op, bytes / sec / 1e9);
+    };
+
+    report("or",    3 * n, bench::best_of(reps, [&] { exec.assign_or(a, b); bench::keep(a.word_data()); }));
+    report("count", 1 * n, bench::best_of(reps, [&] { bench::keep(exec.count(a)); }));
+    report("fill",  1 * n, bench::best_of(reps, [&] { exec.assign(a, __bits, true); bench::keep(a.word_data()); }));
+    report("shift", 4 * n, bench::best_of(reps, [&] {
+        exec.lshift(a, 7);
+        exec.rshift(a, 7);
+        bench::keep(a.word_data());
+    }));
+}
+
+int main(int argc, char **argv) {
+    size_t __max = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : std::thread::hardware_concurrency();
+    if (__max == 0) __max = 1;
+    /* 2^30 bits is 128 MiB per array, far past any last level cache. */
+    for (const size_t bits : { size_t{1} << 24, size_t{1} << 30 }) {
+        std::printf("%zu bits (%zu MiB per array)\n", bits, bits / 8 >> 20);
+        for (size_t t = 1 ; ; t *= 2) {
+            run(std::min(t, __max), bits);
+            if (t >= __max) break;
+        }
+    }
+}
@@ -0,0 +1,67 @@
+/**
+ * rank_select against a naive popcount prefix scan, in ns per query.
+ * The scan counts words from the start for rank, and walks them
+ * until the k-th 1 bit for select; it gets fewer queries, as each
+ * one is O(n). Bits are set at random with density one half.
+ */
+#include "container/rank_select.h"
+#include "bench.h"
+#include <cstdio>
+#include <bit>
+#include <random>
+#include <vector>
+
+using dark::dynamic_bitset;
+using dark::rank_select;
+using _Word_t = dark::__detail::__bitset::_Word_t;
+
+static size_t naive_rank(const _Word_t *__bits, size_t __n) {
+    size_t __cnt = 0;
+    for (size_t i = 0 ; i != __n / 64 ; ++i) __cnt += std::popcount(__bits[i]);
+    if (__n % 64) __cnt += std::popcount(__bits[__n / 64] & ((_Word_t{1} << (__n % 64)) - 1));
+    return __cnt;
+}
+
+static size_t naive_select(const _Word_t *__bits, size_t __k) {
+    size_t i = 0;
+    for (;; ++i) {
+        const size_t __cnt = std::popcount(__bits[i]);
+        if (__k < __cnt) break;
+        __k -= __cnt;
+    }
+    auto __word = __bits[i];
+    while (__k--) __word &= __word - 1;
+    return i * 64 + std::countr_zero(__word);
+}
+
+int main() {
+    std::mt19937_64 rng(1);
+    for (const size_t bits : { size_t{1} << 20, size_t{1} << 24, size_t{1} << 28 }) {
+        dynamic_bitset b(bits);
+        for (size_t i = 0 ; i != b.word_count() ; ++i) b.word_data()[i] = rng();
+        b.flip(), b.flip(); // Clear the bits past the length, if any.
+
+        double build = bench::best_of(3, [&] { bench::keep(rank_select(b)); });
+        const rank_select index(b);
+        const auto ones = index.count();
+
+        const size_t fast = 1 << 20, slow = std::max <size_t> (16, (size_t{1} << 30) / bits);
+        std::vector <size_t> pos(fast), nth(fast);
+        for (auto &x : pos) x = rng() % (bits + 1);
+        for (auto &x : nth) x = rng() % ones;
+
+        size_t sink = 0;
+        const auto ns = [](double sec, size_t q) { return sec / double(q) * 1e9; };
+        const auto rank_fast = bench::best_of(3, [&] { for (auto x : pos) sink += index.rank(x); });
+        const auto sel_fast  = bench::best_of(3, [&] { for (auto x : nth) sink += index.select(x); });
+        const auto rank_slow = bench::best_of(3, [&] { for (size_t i = 0 ; i != slow ; ++i) sink += naive_rank(b.word_data(), pos[i]); });
+        const auto sel_slow  = bench::best_of(3, [&] { for (size_t i = 0 ; i != slow ; ++i) sink += naive_select(b.word_data(), nth[i]); });
+        bench::keep(sink);
+
+        std::printf("2^%d bits: build %.2f ms, index %.2f%% of the bits\n", std::countr_zero(bits), build * 1e3,
+            100.0 * double(sizeof(_Word_t) * (index.upper_data().size() + index.entry_data().size())
+                         + sizeof(uint32_t) * index.hints_data().size()) / double(bits / 8));
+        std::printf("  rank    %10.1f ns  (scan %12.1f ns)\n", ns(rank_fast, fast), ns(rank_slow, slow));
+        std::printf("  select  %10.1f ns  (scan %12.1f ns)\n", ns(sel_fast, fast), ns(sel_slow, slow));
+    }
+}
@@ -0,0 +1,71 @@
+/**
+ * rb_set against std::set and __gnu_pbds::tree (with order
+ * statistics), in ns per operation on 2^16 and 2^20 random int
+ * keys; the larger set is bound by cache misses. Lookups and
+ * ranks hit a present key half the time. std::set has no rank,
+ * which would be an O(n) std::distance there, so it has no rank
+ * column. rb_set is run with both the default allocator and
+ * pool_allocator.
+ */
+#include "container/rb_tree.h"
+#include "bench.h"
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <set>
+#include <type_traits>
+#include <vector>
+#include <ext/pb_ds/assoc_container.hpp>
+#include <ext/pb_ds/tree_policy.hpp>
+
+using pbds_tree = __gnu_pbds::tree <int, __gnu_pbds::null_type, std::less <int>,
+    __gnu_pbds::rb_tree_tag, __gnu_pbds::tree_order_statistics_node_update>;
+
+std::vector <int> keys, probes;
+
+/* Time __fn(x) over each x in __xs, in ns per call. */
+template <typename _Fn>
+static double per_op(const std::vector <int> &__xs, _Fn &&__fn) {
+    const auto __beg = std::chrono::steady_clock::now();
+    for (const auto x : __xs) __fn(x);
+    const auto __end = std::chrono::steady_clock::now();
+    return std::chrono::duration <double, std::nano> (__end - __beg).count() / double(__xs.size());
+}
+
+template <typename _Set, typename _Rank>
+static void run(const char *__name, _Rank __rank) {
+    _Set s;
+    constexpr bool __has_rank = !std::is_same_v <_Rank, std::nullptr_t>;
+    size_t __sink = 0;
+    const auto __insert = per_op(keys,   [&](int x) { s.insert(x); });
+    const auto __find   = per_op(probes, [&](int x) { __sink += s.find(x) != s.end(); });
+    double __ranks = 0;
+    if constexpr (__has_rank)
+        __ranks = per_op(probes, [&](int x) { __sink += __rank(s, x); });
+    const auto __erase  = per_op(keys,   [&](int x) { s.erase(x); });
+    bench::keep(__sink);
+
+    std::printf("  %-14s insert %6.1f  find %6.1f  ", __name, __insert, __find);
+    if constexpr (__has_rank) std::printf("rank %6.1f", __ranks);
+    else                      std::printf("rank %6s", "-");
+    std::printf("  erase %6.1f ns\n", __erase);
+}
+
+int main() {
+    const auto rb_rank   = [](const auto &s, int x) { return s.rank(x); };
+    const auto pbds_rank = [](const auto &s, int x) { return s.order_of_key(x); };
+
+    for (const size_t n : { size_t{1} << 16, size_t{1} << 20 }) {
+        std::mt19937 rng(1);
+        keys.clear();
+        probes.clear();
+        for (size_t i = 0 ; i != n ; ++i) keys.push_back(int(rng()));
+        for (size_t i = 0 ; i != n ; ++i) probes.push_back(rng() & 1 ? keys[rng() % n] : int(rng()));
+
+        std::printf("%zu keys\n", n);
+        run <std::set <int>> ("std::set", nullptr);
+        run <pbds_tree> ("pbds tree", pbds_rank);
+        run <dark::rb_set <int>> ("rb_set", rb_rank);
+        run <dark::rb_set <int, std::less <int>, dark::pool_allocator <int>>> ("rb_set (pool)", rb_rank);
+    }
+}
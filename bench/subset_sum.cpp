@@ -0,0 +1,83 @@
+/**
+ * Subset sum (which totals up to S are reachable from a multiset of
+ * weights), by the bitset step dp |= dp << w. The fused
+ * or_shifted_left(w) is compared against the plain forms:
+ * dynamic_bitset has no binary <<, so there it is copy, <<=, |=;
+ * static_bitset and std::bitset spell it dp |= dp << w. All of them
+ * must agree on the number of reachable sums. Times in ms per solve.
+ */
+#include "container/bitset.h"
+#include "bench.h"
+#include <bitset>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+using dark::dynamic_bitset;
+using dark::static_bitset;
+
+inline constexpr size_t S = 1000000; // Largest sum tracked
+inline constexpr int    reps = 5;
+
+static size_t plain_dynamic(const std::vector <size_t> &__w) {
+    dynamic_bitset dp(S + 1);
+    dp.set(0);
+    for (const auto w : __w) {
+        auto __tmp = dp;
+        __tmp <<= w;
+        dp |= __tmp;
+    }
+    return dp.count();
+}
+
+static size_t fused_dynamic(const std::vector <size_t> &__w) {
+    dynamic_bitset dp(S + 1);
+    dp.set(0);
+    for (const auto w : __w) dp.or_shifted_left(w);
+    return dp.count();
+}
+
+/* Static bitsets of S bits are heap allocated, not on the stack. */
+static size_t plain_static(const std::vector <size_t> &__w) {
+    auto dp = std::make_unique <static_bitset <S + 1>> ();
+    dp->set(0);
+    for (const auto w : __w) *dp |= *dp << w;
+    return dp->count();
+}
+
+static size_t fused_static(const std::vector <size_t> &__w) {
+    auto dp = std::make_unique <static_bitset <S + 1>> ();
+    dp->set(0);
+    for (const auto w : __w) dp->or_shifted_left(w);
+    return dp->count();
+}
+
+static size_t plain_std(const std::vector <size_t> &__w) {
+    auto dp = std::make_unique <std::bitset <S + 1>> ();
+    dp->set(0);
+    for (const auto w : __w) *dp |= *dp << w;
+    return dp->count();
+}
+
+int main() {
+    std::mt19937_64 rng(1);
+    for (const size_t n : { 200, 2000 }) {
+        std::vector <size_t> w(n);
+        for (auto &x : w) x = rng() % (2 * S / n) + 1;
+
+        std::printf("S = %zu, %zu weights\n", S, n);
+        size_t __ans = 0;
+        const auto run = [&](const char *name, size_t (*fn)(const std::vector <size_t> &)) {
+            size_t __cnt = 0;
+            const auto __sec = bench::best_of(reps, [&] { __cnt = fn(w); bench::keep(__cnt); });
+            if (__ans == 0) __ans = __cnt;
+            std::printf("  %-16s %8.2f ms%s\n", name, __sec * 1e3, __cnt == __ans ? "" : "  MISMATCH");
+        };
+        run("dynamic plain",  plain_dynamic);
+        run("dynamic fused",  fused_dynamic);
+        run("static plain",   plain_static);
+        run("static fused",   fused_static);
+        run("std::bitset",    plain_std);
+    }
+}
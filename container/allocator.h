@@ -4,6 +4,11 @@
 #include <cstdlib>
 #include <bits/allocator.h>
 #include <type_traits>
+#include <algorithm>
+#include <utility>
+#include <mutex>
+#include <bit>
+#include <new>
 
 namespace dark {
 
@@ -45,11 +50,14 @@ struct allocator {
     }
 
     [[nodiscard,__gnu__::__always_inline__]]
-    constexpr static _Tp *reallocate(_Tp *__ptr, size_t __n) {
+    constexpr static _Tp *reallocate(_Tp *__ptr, size_t __old, size_t __n) {
         static_assert(std::is_trivial_v <_Tp>,
             "Only trivial types are allowed in realloc now.");
         if (std::is_constant_evaluated()) {
-            return std::allocator <_Tp> {}.reallocate(__ptr,__n);
+            auto *__raw = std::allocator <_Tp> {}.allocate(__n);
+            for (size_t i = 0; i < __old && i < __n; ++i) __raw[i] = __ptr[i];
+            if (__ptr != nullptr) std::allocator <_Tp> {}.deallocate(__ptr,__old);
+            return __raw;
         } else {
             return static_cast <_Tp *> (::std::realloc(__ptr,__n * __N));
         }
@@ -67,4 +75,251 @@ struct allocator {
     }
 };
 
+
+namespace __detail::__pool {
+
+/* A free block, linked through its own first bytes. */
+struct free_block { free_block *next; };
+
+/* Round __n up to a multiple of __a, a power of 2. */
+inline constexpr size_t align_up(size_t __n, size_t __a) { return (__n + __a - 1) & ~(__a - 1); }
+
+/* Bytes per page, the smallest slab. */
+inline constexpr size_t __PageBytes = 4096;
+/* Slabs double in size up to this. */
+inline constexpr size_t __MaxSlab   = size_t{1} << 18;
+/* Blocks moved between a thread cache and the shared pool at once. */
+inline constexpr size_t __Batch = 32;
+
+/**
+ * Blocks of _Size bytes carved from page-aligned slabs. Freed blocks
+ * go to an intrusive free list; fresh slabs are carved by bumping a
+ * pointer, so blocks allocated together sit together. Each slab is
+ * twice the last (up to __MaxSlab), so a growing pool makes few calls
+ * to malloc. Slabs are only returned on destruction. Not thread-safe.
+ */
+template <size_t _Size, size_t _Align>
+struct slab_pool {
+    static_assert(_Size >= sizeof(free_block) && _Size % _Align == 0,
+        "Block size must hold a pointer and keep alignment now.");
+
+    /* Bytes before the first block: link to the previous slab. */
+    inline static constexpr size_t __Head = align_up(sizeof(void *), _Align);
+    /* First slab: at least one page, and at least 32 blocks. */
+    inline static constexpr size_t __Slab = std::max(__PageBytes, std::bit_ceil(32 * _Size + __Head));
+
+    free_block *free {};    // Free list
+    char *      cur  {};    // Uncarved part of the newest slab
+    char *      end  {};    // End of the newest slab
+    void *      slabs{};    // Slab list, linked through the head of each slab
+    size_t      next {__Slab}; // Bytes of the next slab
+
+    slab_pool() = default;
+    slab_pool(slab_pool &&__rhs) noexcept
+        : free(std::exchange(__rhs.free, nullptr)),
+          cur(std::exchange(__rhs.cur, nullptr)),
+          end(std::exchange(__rhs.end, nullptr)),
+          slabs(std::exchange(__rhs.slabs, nullptr)),
+          next(std::exchange(__rhs.next, __Slab)) {}
+    slab_pool &operator = (slab_pool &&__rhs) noexcept {
+        slab_pool __tmp(std::move(__rhs));
+        std::swap(free, __tmp.free);
+        std::swap(cur, __tmp.cur);
+        std::swap(end, __tmp.end);
+        std::swap(slabs, __tmp.slabs);
+        std::swap(next, __tmp.next);
+        return *this;
+    }
+    ~slab_pool() {
+        while (slabs != nullptr)
+            std::free(std::exchange(slabs, *static_cast <void **> (slabs)));
+    }
+
+    [[__gnu__::__noinline__]]
+    void grow() {
+        auto *__raw = static_cast <char *> (std::aligned_alloc(__PageBytes, next));
+        if (__raw == nullptr) throw std::bad_alloc();
+        *reinterpret_cast <void **> (__raw) = slabs;
+        slabs = __raw;
+        cur = __raw + __Head;
+        end = __raw + next;
+        next = std::min(next * 2, std::max(next, __MaxSlab));
+    }
+
+    void *allocate() {
+        if (free != nullptr) return std::exchange(free, free->next);
+        if (end - cur < static_cast <ptrdiff_t> (_Size)) this->grow();
+        return std::exchange(cur, cur + _Size);
+    }
+
+    void deallocate(void *__ptr) noexcept {
+        auto *__block = static_cast <free_block *> (__ptr);
+        __block->next = free;
+        free = __block;
+    }
+};
+
+/**
+ * The process-wide pool of one block size, behind a mutex.
+ * Threads reach it only in batches, through their caches.
+ * Never destroyed: blocks may be freed during static destruction.
+ */
+template <size_t _Size, size_t _Align>
+struct shared_pool {
+    std::mutex lock;
+    slab_pool <_Size, _Align> pool;
+
+    static shared_pool &instance() {
+        static auto *__ptr = new shared_pool;
+        return *__ptr;
+    }
+
+    /* Pop __n blocks as a list. */
+    free_block *take(size_t __n) {
+        std::lock_guard __guard {lock};
+        free_block *__head = nullptr;
+        while (__n-- != 0) {
+            auto *__block = static_cast <free_block *> (pool.allocate());
+            __block->next = __head;
+            __head = __block;
+        }
+        return __head;
+    }
+
+    /* Push a list of blocks. */
+    void give(free_block *__head) {
+        std::lock_guard __guard {lock};
+        while (__head != nullptr)
+            pool.deallocate(std::exchange(__head, __head->next));
+    }
+};
+
+/* Per-thread free list in front of the shared pool. */
+template <size_t _Size, size_t _Align>
+struct thread_cache {
+    free_block *free {};    // Cached blocks
+    size_t      count{};    // Number of cached blocks
+
+    static thread_cache &instance() {
+        thread_local thread_cache __cache;
+        return __cache;
+    }
+
+    ~thread_cache() {
+        shared_pool <_Size, _Align>::instance().give(free);
+        free  = nullptr;
+        count = 0;
+    }
+
+    void *allocate() {
+        if (free == nullptr) {
+            free  = shared_pool <_Size, _Align>::instance().take(__Batch);
+            count = __Batch;
+        }
+        --count;
+        return std::exchange(free, free->next);
+    }
+
+    void deallocate(void *__ptr) {
+        auto *__block = static_cast <free_block *> (__ptr);
+        __block->next = free;
+        free = __block;
+        if (++count < __Batch * 2) return;
+        /* Too many cached: hand the oldest __Batch back. */
+        auto *__tail = free;
+        for (size_t i = 1 ; i != __Batch ; ++i) __tail = __tail->next;
+        shared_pool <_Size, _Align>::instance().give(std::exchange(__tail->next, nullptr));
+        count = __Batch;
+    }
+};
+
+/* Alignment and block size of the size class of _Tp. */
+template <class _Tp>
+inline constexpr size_t __Align = std::max(alignof(_Tp), alignof(free_block));
+template <class _Tp>
+inline constexpr size_t __Size  = align_up(std::max(sizeof(_Tp), sizeof(free_block)), __Align <_Tp>);
+
+} // namespace __detail::__pool
+
+
+/**
+ * Node allocator owning a private slab pool. Single objects come
+ * from the pool, arrays fall back to malloc. Nodes of one container
+ * share pages, and are freed all at once with the allocator.
+ * A copy starts with a new empty pool, so copies never compare equal:
+ * meant for node-based containers which allocate through one object.
+ */
+template <class _Tp>
+struct pool_allocator {
+  private:
+    using _Pool_t = __detail::__pool::slab_pool <
+        __detail::__pool::__Size <_Tp>, __detail::__pool::__Align <_Tp>>;
+    _Pool_t pool;
+
+  public:
+    template <class U>
+    struct rebind { using other = pool_allocator<U>; };
+
+    using size_type         = size_t;
+    using difference_type   = ptrdiff_t;
+    using value_type        = _Tp;
+    using pointer           = _Tp *;
+    using const_pointer     = const _Tp *;
+
+    pool_allocator() = default;
+    pool_allocator(const pool_allocator &) noexcept : pool() {}
+    pool_allocator(pool_allocator &&) noexcept = default;
+    pool_allocator &operator = (const pool_allocator &) noexcept { return *this; }
+    pool_allocator &operator = (pool_allocator &&) noexcept = default;
+
+    [[nodiscard]] _Tp *allocate(size_t __n) {
+        if (__n != 1) return allocator <_Tp>::allocate(__n);
+        return static_cast <_Tp *> (pool.allocate());
+    }
+
+    void deallocate(_Tp *__ptr, size_t __n) noexcept {
+        if (__n != 1) return allocator <_Tp>::deallocate(__ptr, __n);
+        pool.deallocate(__ptr);
+    }
+
+    friend bool operator == (const pool_allocator &__lhs, const pool_allocator &__rhs) {
+        return &__lhs == &__rhs;
+    }
+};
+
+/**
+ * Stateless node allocator over a process-wide slab pool per size
+ * class, with a per-thread cache of free blocks in front of it.
+ * Any instance may free what another allocated, in any thread.
+ * Pool memory is kept for reuse and never returned to the system.
+ */
+template <class _Tp>
+struct shared_pool_allocator {
+  private:
+    using _Cache_t = __detail::__pool::thread_cache <
+        __detail::__pool::__Size <_Tp>, __detail::__pool::__Align <_Tp>>;
+
+  public:
+    template <class U>
+    struct rebind { using other = shared_pool_allocator<U>; };
+
+    using size_type         = size_t;
+    using difference_type   = ptrdiff_t;
+    using value_type        = _Tp;
+    using pointer           = _Tp *;
+    using const_pointer     = const _Tp *;
+
+    [[nodiscard]] static _Tp *allocate(size_t __n) {
+        if (__n != 1) return allocator <_Tp>::allocate(__n);
+        return static_cast <_Tp *> (_Cache_t::instance().allocate());
+    }
+
+    static void deallocate(_Tp *__ptr, size_t __n) noexcept {
+        if (__n != 1) return allocator <_Tp>::deallocate(__ptr, __n);
+        _Cache_t::instance().deallocate(__ptr);
+    }
+
+    friend constexpr bool operator == (shared_pool_allocator, shared_pool_allocator) { return true; }
+};
+
 } // namespace dark
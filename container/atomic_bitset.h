@@ -0,0 +1,218 @@
+#pragma once
+#include "bitset.h"
+#include <atomic>
+#include <memory>
+
+namespace dark {
+
+
+/* How atomic_bitset places words in memory. */
+enum class atomic_layout {
+    dense,      // Words are contiguous: smallest, most false sharing
+    padded,     // One word per cache line: 8x memory, no false sharing
+    striped,    // Neighbouring words sit on different cache lines
+};
+
+
+namespace __detail::__atomic_bitset {
+
+using __bitset::_Word_t;
+using __bitset::__WBits;
+
+/* Words per cache line. */
+inline constexpr size_t __LineWords = 64 / sizeof(_Word_t);
+
+template <atomic_layout _Layout>
+struct alignas(_Layout == atomic_layout::padded ? 64 : sizeof(_Word_t)) slot {
+    std::atomic <_Word_t> word {0};
+};
+
+static_assert(std::atomic <_Word_t>::is_always_lock_free,
+    "atomic_bitset requires lock-free words now.");
+
+/* Order for a load standing in for an RMW of order __o: drop the release part. */
+inline constexpr std::memory_order load_order(std::memory_order __o) {
+    switch (__o) {
+        case std::memory_order_release: return std::memory_order_relaxed;
+        case std::memory_order_acq_rel: return std::memory_order_acquire;
+        default:                        return __o;
+    }
+}
+
+} // namespace __detail::__atomic_bitset
+
+
+/**
+ * A fixed-size bitset whose bits can be changed by many threads.
+ * Every write is a single atomic read-modify-write on one word.
+ * Bulk reads (count, find, snapshot) use relaxed loads, so they
+ * are only exact once the writers are done (e.g. after a join).
+ */
+template <atomic_layout _Layout = atomic_layout::dense>
+struct atomic_bitset {
+  private:
+    using _Word_t = __detail::__bitset::_Word_t;
+    using _Slot_t = __detail::__atomic_bitset::slot <_Layout>;
+
+    std::unique_ptr <_Slot_t []> slots;
+    size_t length;  // Number of bits
+    size_t lines;   // Cache lines, for the striped layout
+
+    /* Slot of the __n-th logical word. */
+    size_t index(size_t __n) const {
+        using __detail::__atomic_bitset::__LineWords;
+        if constexpr (_Layout == atomic_layout::striped)
+            return __n % lines * __LineWords + __n / lines;
+        else
+            return __n;
+    }
+
+    /* Number of slots to allocate for __n words. */
+    size_t slot_count(size_t __n) const {
+        using __detail::__atomic_bitset::__LineWords;
+        if constexpr (_Layout == atomic_layout::striped)
+            return lines * __LineWords;
+        else
+            return __n;
+    }
+
+    std::atomic <_Word_t> &word(size_t __n) const { return slots[this->index(__n)].word; }
+
+  public:
+    inline static constexpr size_t npos = -1;
+
+    atomic_bitset() noexcept : slots(), length(), lines() {}
+
+    /* Create __n bits, all 0. */
+    explicit atomic_bitset(size_t __n) : length(__n) {
+        using __detail::__atomic_bitset::__LineWords;
+        const auto __words = this->word_count();
+        lines = (__words + __LineWords - 1) / __LineWords;
+        slots.reset(new _Slot_t [this->slot_count(__words)]);
+    }
+
+    atomic_bitset(atomic_bitset &&) noexcept = default;
+    atomic_bitset &operator = (atomic_bitset &&) noexcept = default;
+
+    size_t size() const { return length; }
+    size_t word_count() const { return __detail::__bitset::div_ceil(length); }
+
+  public:
+    /* Section of atomic single-bit operations. */
+
+    bool test(size_t __n, std::memory_order __o = std::memory_order_relaxed) const {
+        const auto [__div, __mod] = __detail::__bitset::div_mod(__n);
+        return (this->word(__div).load(__o) >> __mod) & 1;
+    }
+
+    void set(size_t __n, std::memory_order __o = std::memory_order_relaxed) {
+        this->test_and_set(__n, __o);
+    }
+
+    void reset(size_t __n, std::memory_order __o = std::memory_order_relaxed) {
+        this->test_and_reset(__n, __o);
+    }
+
+    /* Set the bit to 1. Return whether it was 1 before. */
+    bool test_and_set(size_t __n, std::memory_order __o = std::memory_order_acq_rel) {
+        const auto [__div, __mod] = __detail::__bitset::div_mod(__n);
+        const auto __bit = __detail::__bitset::mask_pos(__mod);
+        auto &__word = this->word(__div);
+        /**
+         * Plain load first: claimed bits need no locked instruction.
+         * The load keeps the acquire part of __o, so a loser still
+         * sees what the winner published through the bit.
+         */
+        const auto __load = __detail::__atomic_bitset::load_order(__o);
+        if (__word.load(__load) & __bit) return true;
+        return __word.fetch_or(__bit, __o) & __bit;
+    }
+
+    /* Set the bit to 0. Return whether it was 1 before. */
+    bool test_and_reset(size_t __n, std::memory_order __o = std::memory_order_acq_rel) {
+        const auto [__div, __mod] = __detail::__bitset::div_mod(__n);
+        const auto __bit = __detail::__bitset::mask_pos(__mod);
+        auto &__word = this->word(__div);
+        const auto __load = __detail::__atomic_bitset::load_order(__o);
+        if (!(__word.load(__load) & __bit)) return false;
+        return __word.fetch_and(~__bit, __o) & __bit;
+    }
+
+  public:
+    /* Section of atomic whole-word operations. */
+
+    /* Load the __n-th word. */
+    _Word_t load_word(size_t __n, std::memory_order __o = std::memory_order_relaxed) const {
+        return this->word(__n).load(__o);
+    }
+
+    /**
+     * Or __mask into the __n-th word (bits [64n, 64n + 64)).
+     * Mask bits beyond size() must be 0. Return the old word.
+     */
+    _Word_t fetch_or(size_t __n, _Word_t __mask, std::memory_order __o = std::memory_order_acq_rel) {
+        return this->word(__n).fetch_or(__mask, __o);
+    }
+
+    /* And __mask into the __n-th word. Return the old word. */
+    _Word_t fetch_and(size_t __n, _Word_t __mask, std::memory_order __o = std::memory_order_acq_rel) {
+        return this->word(__n).fetch_and(__mask, __o);
+    }
+
+  public:
+    /* Section of relaxed bulk reads. Exact only without concurrent writers. */
+
+    size_t count() const {
+        size_t __cnt = 0;
+        for (size_t i = 0 ; i != this->word_count() ; ++i)
+            __cnt += std::popcount(this->load_word(i));
+        return __cnt;
+    }
+
+    bool none() const {
+        for (size_t i = 0 ; i != this->word_count() ; ++i)
+            if (this->load_word(i) != 0) return false;
+        return true;
+    }
+
+    bool any() const { return !this->none(); }
+
+    /* Return the index of the first 1 bit, or npos if none. */
+    size_t find_first() const { return this->find_from(0); }
+
+    /* Return the index of the first 1 bit after __n, or npos if none. */
+    size_t find_next(size_t __n) const {
+        if (__n == npos) return npos;
+        return this->find_from(__n + 1);
+    }
+
+    /* Copy all bits into a plain bitset. */
+    dynamic_bitset snapshot() const {
+        dynamic_bitset __ret(length);
+        const auto __dst = __ret.word_data();
+        for (size_t i = 0 ; i != this->word_count() ; ++i)
+            __dst[i] = this->load_word(i);
+        return __ret;
+    }
+
+    /* Set all bits to 0. Must not race with writers. */
+    void clear() {
+        for (size_t i = 0 ; i != this->word_count() ; ++i)
+            this->word(i).store(0, std::memory_order_relaxed);
+    }
+
+  private:
+    size_t find_from(size_t __n) const {
+        if (__n >= length) return npos;
+        auto [__div, __mod] = __detail::__bitset::div_mod(__n);
+        auto __word = this->load_word(__div) & __detail::__bitset::mask_top(__mod);
+        while (__word == 0) {
+            if (++__div == this->word_count()) return npos;
+            __word = this->load_word(__div);
+        }
+        return __div * __detail::__bitset::__WBits + std::countr_zero(__word);
+    }
+};
+
+
+} // namespace dark
@@ -0,0 +1,261 @@
+#pragma once
+#include "bitset.h"
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+namespace dark {
+
+
+namespace __detail::__matrix {
+
+using __bitset::_Word_t;
+using __bitset::__WBits;
+
+/* Rows combined per Four Russians table (table has 2^__K rows). */
+inline constexpr size_t __K = 8;
+
+/**
+ * Transpose a 64x64 block in place.
+ * Bit j of __a[i] is element (i, j).
+ * Swap off-diagonal blocks of size 32, 16, ..., 1.
+ */
+inline constexpr void transpose_block(_Word_t (&__a)[__WBits]) {
+    _Word_t __mask = 0x00000000ffffffff;
+    for (size_t j = 32 ; j != 0 ; j >>= 1, __mask ^= __mask << j) {
+        for (size_t k = 0 ; k < __WBits ; k = ((k | j) + 1) & ~j) {
+            const auto __t = ((__a[k] >> j) ^ __a[k | j]) & __mask;
+            __a[k | j] ^= __t;
+            __a[k]     ^= __t << j;
+        }
+    }
+}
+
+/* Read __K bits of a row, starting at bit __n. */
+inline constexpr size_t read_bits(const _Word_t *__row, size_t __n) {
+    const auto [__div, __mod] = __bitset::div_mod(__n);
+    return (__row[__div] >> __mod) & __bitset::mask_low(__K);
+}
+
+} // namespace __detail::__matrix
+
+
+/**
+ * A dense matrix over GF(2).
+ * Rows are stored back to back in one array, each padded to a
+ * whole number of words; unused bits of each row are kept 0.
+ * Row operations go through the dynamic_bitset kernels.
+ */
+struct bit_matrix {
+  private:
+    using _Word_t = __detail::__bitset::_Word_t;
+
+    size_t  n_rows; // Number of rows
+    size_t  n_cols; // Number of columns
+    size_t  stride; // Words per row
+    std::vector <_Word_t> words;
+
+    size_t row_bits() const { return stride * __detail::__bitset::__WBits; }
+
+    /**
+     * Four Russians product: for each group of __K rows of __rhs, build
+     * all 2^__K combinations (xor, or or if !_Xor), then add one table row
+     * per row of __lhs, chosen by the __K matching bits of that row.
+     */
+    template <bool _Xor>
+    static bit_matrix m4rm(const bit_matrix &__lhs, const bit_matrix &__rhs) {
+        using namespace __detail::__matrix;
+        if (__lhs.n_cols != __rhs.n_rows)
+            throw std::invalid_argument("bit_matrix: Dimension mismatch.");
+
+        bit_matrix __ret(__lhs.n_rows, __rhs.n_cols);
+        const auto __w = __ret.stride;
+        const auto __n = __ret.row_bits();
+        std::vector <_Word_t> __table((size_t{1} << __K) * __w);
+
+        for (size_t g = 0 ; g < __lhs.n_cols ; g += __K) {
+            const auto __cnt = std::min(__K, __lhs.n_cols - g);
+            for (size_t m = 1 ; m != (size_t{1} << __cnt) ; ++m) {
+                const auto __dst = __table.data() + m * __w;
+                const auto __low = __table.data() + (m & (m - 1)) * __w;
+                std::copy_n(__low, __w, __dst);
+                const auto __row = __rhs.row_data(g + std::countr_zero(m));
+                if constexpr (_Xor) __detail::__bitset::do_xor(__dst, __row, __n);
+                else                __detail::__bitset::do_or_(__dst, __row, __n);
+            }
+            for (size_t i = 0 ; i != __lhs.n_rows ; ++i) {
+                const auto __m = read_bits(__lhs.row_data(i), g);
+                if (__m == 0) continue;
+                const auto __src = __table.data() + __m * __w;
+                if constexpr (_Xor) __detail::__bitset::do_xor(__ret.row_data(i), __src, __n);
+                else                __detail::__bitset::do_or_(__ret.row_data(i), __src, __n);
+            }
+        }
+        return __ret;
+    }
+
+  public:
+    bit_matrix() : n_rows(), n_cols(), stride() {}
+
+    /* A zero matrix of __r rows and __c columns. */
+    bit_matrix(size_t __r, size_t __c)
+        : n_rows(__r), n_cols(__c), stride(__detail::__bitset::div_ceil(__c)),
+          words(__r * stride) {}
+
+    static bit_matrix identity(size_t __n) {
+        bit_matrix __ret(__n, __n);
+        for (size_t i = 0 ; i != __n ; ++i) __ret.set(i, i);
+        return __ret;
+    }
+
+    size_t rows() const { return n_rows; }
+    size_t cols() const { return n_cols; }
+
+    /* Words per row. */
+    size_t row_words() const { return stride; }
+    /* Raw words of row __i. Unused bits must be kept 0. */
+    _Word_t *row_data(size_t __i) { return words.data() + __i * stride; }
+    /* Raw words of row __i. Unused bits are always 0. */
+    const _Word_t *row_data(size_t __i) const { return words.data() + __i * stride; }
+
+    bool test(size_t __i, size_t __j) const {
+        const auto [__div, __mod] = __detail::__bitset::div_mod(__j);
+        return (this->row_data(__i)[__div] >> __mod) & 1;
+    }
+    void set(size_t __i, size_t __j, bool __x = true) {
+        const auto [__div, __mod] = __detail::__bitset::div_mod(__j);
+        auto &__word = this->row_data(__i)[__div];
+        __word = (__word & ~__detail::__bitset::mask_pos(__mod)) | (_Word_t(__x) << __mod);
+    }
+    void reset(size_t __i, size_t __j) { this->set(__i, __j, false); }
+    void flip(size_t __i, size_t __j) {
+        const auto [__div, __mod] = __detail::__bitset::div_mod(__j);
+        this->row_data(__i)[__div] ^= __detail::__bitset::mask_pos(__mod);
+    }
+
+    /* Copy of row __i. */
+    dynamic_bitset row(size_t __i) const {
+        dynamic_bitset __ret(n_cols);
+        std::copy_n(this->row_data(__i), stride, __ret.word_data());
+        return __ret;
+    }
+    /* Replace row __i, which must have cols() bits. */
+    void set_row(size_t __i, const dynamic_bitset &__row) {
+        if (__row.size() != n_cols)
+            throw std::invalid_argument("bit_matrix: Dimension mismatch.");
+        std::copy_n(__row.word_data(), stride, this->row_data(__i));
+    }
+
+    /* Row __dst ^= row __src. */
+    void xor_row(size_t __dst, size_t __src) {
+        __detail::__bitset::do_xor(this->row_data(__dst), this->row_data(__src), this->row_bits());
+    }
+    /* Row __dst &= row __src. */
+    void and_row(size_t __dst, size_t __src) {
+        __detail::__bitset::do_and(this->row_data(__dst), this->row_data(__src), this->row_bits());
+    }
+    void swap_rows(size_t __i, size_t __j) {
+        std::swap_ranges(this->row_data(__i), this->row_data(__i) + stride, this->row_data(__j));
+    }
+
+    friend bool operator == (const bit_matrix &, const bit_matrix &) = default;
+
+  public:
+    /* Transposed copy, built from 64x64 blocks. */
+    bit_matrix transpose() const {
+        using __detail::__bitset::__WBits;
+        bit_matrix __ret(n_cols, n_rows);
+        _Word_t __block[__WBits];
+        for (size_t __bi = 0 ; __bi < n_rows ; __bi += __WBits) {
+            const auto __h = std::min(__WBits, n_rows - __bi);
+            for (size_t __bj = 0 ; __bj < n_cols ; __bj += __WBits) {
+                const auto __w = std::min(__WBits, n_cols - __bj);
+                for (size_t t = 0 ; t != __WBits ; ++t)
+                    __block[t] = t < __h ? this->row_data(__bi + t)[__bj / __WBits] : 0;
+                __detail::__matrix::transpose_block(__block);
+                for (size_t t = 0 ; t != __w ; ++t)
+                    __ret.row_data(__bj + t)[__bi / __WBits] = __block[t];
+            }
+        }
+        return __ret;
+    }
+
+    /* Product over GF(2) (AND-XOR), by the Method of Four Russians. */
+    friend bit_matrix operator * (const bit_matrix &__lhs, const bit_matrix &__rhs) {
+        return m4rm <true> (__lhs, __rhs);
+    }
+
+    /* Boolean product (AND-OR), by the Method of Four Russians. */
+    friend bit_matrix bool_product(const bit_matrix &__lhs, const bit_matrix &__rhs) {
+        return m4rm <false> (__lhs, __rhs);
+    }
+
+    /**
+     * Gaussian elimination in place, __K columns at a time (M4RI).
+     * Pivots of each column block are found and reduced against each
+     * other, then all other rows are cleared by one table lookup each.
+     * With __full, rows above the pivots are cleared too, giving the
+     * reduced row echelon form. Return the rank.
+     */
+    size_t eliminate(bool __full = true) {
+        using namespace __detail::__matrix;
+        const auto __n = this->row_bits();
+        std::vector <_Word_t> __table((size_t{1} << __K) * stride);
+        size_t __index[1 << __K];  // Window bits -> table row
+
+        size_t __rank = 0;
+        for (size_t __col = 0 ; __col < n_cols && __rank < n_rows ; __col += __K) {
+            const auto __end = std::min(__col + __K, n_cols);
+            const auto __top = __rank;
+            size_t __pcol[__K];     // Pivot columns of this block
+            size_t __cnt = 0;       // Number of pivots
+
+            for (auto __c = __col ; __c != __end && __rank < n_rows ; ++__c) {
+                size_t __row = __rank;
+                for (; __row != n_rows ; ++__row) {
+                    for (size_t p = 0 ; p != __cnt ; ++p)
+                        if (this->test(__row, __pcol[p])) this->xor_row(__row, __top + p);
+                    if (this->test(__row, __c)) break;
+                }
+                if (__row == n_rows) continue;
+                this->swap_rows(__row, __rank);
+                for (size_t p = 0 ; p != __cnt ; ++p)
+                    if (this->test(__top + p, __c)) this->xor_row(__top + p, __rank);
+                __pcol[__cnt++] = __c;
+                ++__rank;
+            }
+            if (__cnt == 0) continue;
+
+            /* Pivot rows are the identity on the pivot columns. */
+            for (size_t m = 1 ; m != (size_t{1} << __cnt) ; ++m) {
+                const auto __dst = __table.data() + m * stride;
+                const auto __low = __table.data() + (m & (m - 1)) * stride;
+                std::copy_n(__low, stride, __dst);
+                __detail::__bitset::do_xor(__dst, this->row_data(__top + std::countr_zero(m)), __n);
+            }
+            for (size_t __bits = 0 ; __bits != (size_t{1} << __K) ; ++__bits) {
+                size_t __m = 0;
+                for (size_t p = 0 ; p != __cnt ; ++p)
+                    __m |= ((__bits >> (__pcol[p] - __col)) & 1) << p;
+                __index[__bits] = __m;
+            }
+
+            for (size_t i = __full ? 0 : __rank ; i != n_rows ; ++i) {
+                if (i == __top) { i = __rank - 1; continue; } // Skip pivot rows.
+                const auto __m = __index[read_bits(this->row_data(i), __col)];
+                if (__m != 0)
+                    __detail::__bitset::do_xor(this->row_data(i), __table.data() + __m * stride, __n);
+            }
+        }
+        return __rank;
+    }
+
+    /* Rank over GF(2). */
+    size_t rank() const {
+        auto __copy = *this;
+        return __copy.eliminate(false);
+    }
+};
+
+
+} // namespace dark
@@ -1,16 +1,33 @@
 #pragma once
 #include <bit>
+#include <bitset>
+#include <iostream>
+#include <algorithm>
 #include <cstring>
 #include <climits>
+#include <cstdint>
+#include <iterator>
+#include <concepts>
+#include <functional>
 #include <cstdlib>
 #include <stdexcept>
+#include <string>
+#include <string_view>
 #include "allocator.h"
 
+#if defined(__x86_64__) && !defined(_DARK_NO_SIMD)
+#define _DARK_BITSET_SIMD
+#include <immintrin.h>
+#endif
+
 namespace dark {
 
 
 struct dynamic_bitset;
 
+template <size_t _Nm, typename _Word = size_t>
+struct static_bitset;
+
 
 namespace __detail::__bitset {
 
@@ -44,14 +61,23 @@ alloc_none(size_t __n) { return allocator<_Word_t>::allocate(__n); }
 inline constexpr void deallocate(_Word_t *__ptr, size_t __n)
 { allocator<_Word_t>::deallocate(__ptr, __n); }
 
+/**
+ * Resize heap memory from __old to __new words, keeping the content.
+ * At runtime this is realloc, which may grow in place (glibc grows
+ * large blocks with mremap, so no copy is made).
+ */
+inline constexpr _Word_t *
+reallocate(_Word_t *__ptr, size_t __old, size_t __new)
+{ return allocator<_Word_t>::reallocate(__ptr, __old, __new); }
+
 /* Copy __n words from __src to __dst (memcpy/memmove). */
 template <bool _Move = false>
 inline constexpr void
 word_copy(_Word_t *__dst, const _Word_t *__src, size_t __n) {
     if (std::is_constant_evaluated()) {
         if (__src == __dst) return; // No need to copy.
-        if (__dst < __src + __n && __src < __dst) {
-            // Overlapping, copy from the end.
+        if (_Move && __src < __dst) {
+            // May overlap, copy from the end.
             __dst += __n; __src += __n;
             for (size_t i = 0 ; i != __n ; ++i)
                 *--__dst = *--__src;
@@ -73,9 +99,10 @@ word_copy(_Word_t *__dst, const _Word_t *__src, size_t __n) {
 inline constexpr void
 word_move(_Word_t *__dst, const _Word_t *__src, size_t __n) {
     if (std::is_constant_evaluated()) {
-        if (__dst <= __src && __dst + __n > __src)
-            for (size_t i = __n - 1 ; i >= 0 ; --i)
-                __dst[i] = __src[i];
+        if (__dst <= __src)
+            for (size_t i = 0 ; i != __n ; ++i) __dst[i] = __src[i];
+        else
+            for (size_t i = __n ; i != 0 ; --i) __dst[i - 1] = __src[i - 1];
     } else {
         std::memmove(__dst, __src, __n * sizeof(_Word_t));
     }
@@ -130,6 +157,8 @@ struct reference {
     size_t msk;        // Mask word of the bit
 
     friend class ::dark::dynamic_bitset;
+    template <size_t, typename>
+    friend struct ::dark::static_bitset;
 
     /* ctor */
     constexpr reference(_Word_t *__ptr, size_t __pos)
@@ -154,6 +183,9 @@ struct reference {
     operator = (const reference &rhs) { return *this = bool(rhs); }
 };
 
+/* Words kept inline, before spilling to the heap. */
+inline constexpr size_t __Inline = 2;
+
 /* Custom bit vector. */
 struct dynamic_storage {
   private:
@@ -161,21 +193,63 @@ struct dynamic_storage {
     size_t buffer; // Buffer size
   protected:
     size_t length; // Real length of the bitset
+  private:
+    _Word_t local[__Inline] {}; // Inline words, used when head == local
+
+    /* Point to inline words, or allocate __n words if not enough. */
+    template <bool _Zero>
+    constexpr void init(size_t __n) {
+        if (__n <= __Inline) {
+            head = local; buffer = __Inline;
+        } else {
+            head = _Zero ? alloc_zero(buffer = __n) : alloc_none(buffer = __n);
+        }
+    }
+
+  protected:
+    /* Whether inline words are in use. */
+    constexpr bool is_local() const { return head == local; }
 
-    /* Reallocate memory. */
+    /* Reallocate memory. Only used to grow, so always on heap. */
     constexpr void
     realloc(size_t __n) { head = alloc_none(buffer = __n); }
 
     /* Deallocate memory. */
-    constexpr void dealloc() { deallocate(head, buffer); }
+    constexpr void dealloc() { this->dealloc(head, buffer); }
 
-    /* Deallocate memory. */
-    constexpr static void dealloc(_Word_t *__ptr, size_t __n) {
-        deallocate(__ptr, __n);
+    /* Deallocate memory, unless it is the inline words. */
+    constexpr void dealloc(_Word_t *__ptr, size_t __n) const {
+        if (__ptr != local) deallocate(__ptr, __n);
     }
 
     /* Reset the storage. */
-    constexpr void reset() { head = nullptr; buffer = 0; length = 0; }
+    constexpr void reset() { head = local; buffer = __Inline; length = 0; }
+
+    /**
+     * Change the buffer to hold __n words, __n >= word_count().
+     * Heap buffers are resized with reallocate, in place if possible.
+     * A buffer small enough moves back to the inline words.
+     */
+    constexpr void resize_buffer(size_t __n) {
+        if (__n <= __Inline) {
+            if (this->is_local()) return;
+            word_copy(local, head, this->word_count());
+            this->dealloc();
+            head = local; buffer = __Inline;
+        } else if (this->is_local()) {
+            head = alloc_none(__n);
+            word_copy(head, local, __Inline);
+            buffer = __n;
+        } else {
+            head = reallocate(head, buffer, __n);
+            buffer = __n;
+        }
+    }
+
+    /* Make room for __n words, at least doubling the buffer. */
+    constexpr void grow_buffer(size_t __n) {
+        if (buffer < __n) this->resize_buffer(std::max(__n, buffer * 2));
+    }
 
   public:
     /* ctor & operator section. */
@@ -183,12 +257,12 @@ struct dynamic_storage {
     constexpr ~dynamic_storage()  noexcept { this->dealloc(); }
     constexpr dynamic_storage()   noexcept { this->reset();   }
 
-    constexpr dynamic_storage(size_t __n) {
-        head = alloc_none(buffer = div_ceil(length = __n));
+    constexpr dynamic_storage(size_t __n) : length(__n) {
+        this->init <false> (div_ceil(__n));
     }
 
-    constexpr dynamic_storage(size_t __n, std::nullptr_t) {
-        head = alloc_zero(buffer = div_ceil(length = __n));
+    constexpr dynamic_storage(size_t __n, std::nullptr_t) : length(__n) {
+        this->init <true> (div_ceil(__n));
     }
 
     constexpr dynamic_storage(const dynamic_storage &rhs)
@@ -197,7 +271,12 @@ struct dynamic_storage {
     }
 
     constexpr dynamic_storage(dynamic_storage &&rhs) noexcept {
-        head   = rhs.head;
+        if (rhs.is_local()) {
+            head = local;
+            word_copy(local, rhs.local, __Inline);
+        } else {
+            head = rhs.head;
+        }
         buffer = rhs.buffer;
         length = rhs.length;
         rhs.reset();
@@ -205,11 +284,11 @@ struct dynamic_storage {
 
     constexpr dynamic_storage &operator = (const dynamic_storage &rhs) {
         if (this == &rhs) return *this;
-        if (this->capacity() < rhs.word_count()){
+        if (this->word_capacity() < rhs.word_count()){
             this->dealloc();
-            this->realloc(rhs.length);
-            length = rhs.length;
+            this->realloc(rhs.word_count());
         }
+        length = rhs.length;
         word_copy(head, rhs.head, rhs.word_count());
         return *this;
     }
@@ -222,13 +301,20 @@ struct dynamic_storage {
 
     /* Return the real word in the bitmap */
     constexpr size_t word_count() const { return div_ceil(length); }
-    /* Return the capacity of the storage. */
-    constexpr size_t capacity()   const { return buffer; }
+    /* Return the capacity of the storage, in words. */
+    constexpr size_t word_capacity() const { return buffer; }
 
     constexpr dynamic_storage &swap(dynamic_storage &rhs) {
+        const bool __lhs_local = this->is_local();
+        const bool __rhs_local = rhs.is_local();
         std::swap(head, rhs.head);
         std::swap(buffer, rhs.buffer);
         std::swap(length, rhs.length);
+        for (size_t i = 0 ; i != __Inline ; ++i)
+            std::swap(local[i], rhs.local[i]);
+        /* Inline words moved along, so point to the new place. */
+        if (__lhs_local) rhs.head = rhs.local;
+        if (__rhs_local) head = local;
         return *this;
     }
 
@@ -239,13 +325,7 @@ struct dynamic_storage {
     /* Grow the size by one, and fill with given value in the back. */
     constexpr void grow_full(bool __val) {
         const auto __size = length / __WBits;
-        const auto __capa = this->capacity();
-        if (__size == __capa) {
-            auto *__temp = head;
-            this->realloc(__capa << 1 | !__capa);
-            word_copy(head, __temp, __capa);
-            this->dealloc(__temp, __capa);
-        }
+        this->grow_buffer(__size + 1);
         data(__size) = __val;
     }
 
@@ -258,291 +338,1867 @@ struct dynamic_storage {
     constexpr void clear() noexcept { length = 0; }
 };
 
-inline constexpr void
-do_and(_Word_t *__dst, const _Word_t *__rhs, size_t __n) {
-    const auto [__div, __mod] = div_mod(__n);
-    for (size_t i = 0; i != __div; ++i)
-        __dst[i] &= __rhs[i];
-    if (__mod != 0)
-        __dst[__div] &= __rhs[__div] | mask_top(__mod);
+/* Bulk kernels: full words only, tails are handled by callers. */
+
+/* Word operation of a reduction kernel. */
+enum class reduce_op : size_t { and_, or_, xor_, andn }; // andn: lhs & ~rhs
+
+template <reduce_op _Op>
+inline constexpr _Word_t reduce_word(_Word_t __lhs, _Word_t __rhs) {
+    if constexpr (_Op == reduce_op::and_) return __lhs & __rhs;
+    if constexpr (_Op == reduce_op::or_)  return __lhs | __rhs;
+    if constexpr (_Op == reduce_op::xor_) return __lhs ^ __rhs;
+    if constexpr (_Op == reduce_op::andn) return __lhs & ~__rhs;
 }
 
-inline constexpr void
-do_or_(_Word_t *__dst, const _Word_t *__rhs, size_t __n) {
-    const auto [__div, __mod] = div_mod(__n);
-    for (size_t i = 0; i != __div; ++i)
-        __dst[i] |= __rhs[i];
-    if (__mod != 0)
-        __dst[__div] |= __rhs[__div] & mask_low(__mod);
+/* Portable word-by-word kernels. */
+namespace __scalar {
+
+inline void do_and(_Word_t *__dst, const _Word_t *__src, size_t __n) {
+    for (size_t i = 0 ; i != __n ; ++i) __dst[i] &= __src[i];
 }
 
-inline constexpr void
-do_xor(_Word_t *__dst, const _Word_t *__rhs, size_t __n) {
-    const auto [__div, __mod] = div_mod(__n);
-    for (size_t i = 0; i != __div; ++i)
-        __dst[i] ^= __rhs[i];
-    if (__mod != 0)
-        __dst[__div] ^= __rhs[__div] & mask_low(__mod);
+inline void do_or_(_Word_t *__dst, const _Word_t *__src, size_t __n) {
+    for (size_t i = 0 ; i != __n ; ++i) __dst[i] |= __src[i];
 }
 
-static_assert(std::endian::native == std::endian::little,
-    "Our implement only supports little endian now.");
+inline void do_xor(_Word_t *__dst, const _Word_t *__src, size_t __n) {
+    for (size_t i = 0 ; i != __n ; ++i) __dst[i] ^= __src[i];
+}
 
-/* 2-pointer small struct. */
-struct vec2 { _Word_t *dst; const _Word_t *src; };
+inline void do_not(_Word_t *__dst, size_t __n) {
+    for (size_t i = 0 ; i != __n ; ++i) __dst[i] = ~__dst[i];
+}
 
-inline static constexpr vec2
-operator << (vec2 __vec, size_t __n) { return {__vec.dst, __vec.src - __n}; }
-inline static constexpr vec2
-operator >> (vec2 __vec, size_t __n) { return {__vec.dst, __vec.src + __n}; }
-inline static constexpr vec2
-operator + (vec2 __vec, size_t __n) { return {__vec.dst + __n, __vec.src + __n}; }
+inline size_t count(const _Word_t *__src, size_t __n) {
+    size_t __cnt = 0;
+    for (size_t i = 0 ; i != __n ; ++i) __cnt += std::popcount(__src[i]);
+    return __cnt;
+}
 
-/* Lshift word by word (with memmove) */
-inline constexpr void
-word_lshift(vec2 __vec, size_t __n, size_t __shift) {
-    if (__shift == 0) return;
-    const auto [__dst, __src] = __vec;
-    const auto __offset = __shift / __WBits;
-    const auto __count  = div_ceil(__n) - __offset;
-    word_copy<true>(__dst + __offset, __src, __count);
-    return word_reset(__dst, 0, __offset);
+inline size_t sum(const _Word_t *__src, size_t __n) {
+    size_t __cnt = 0;
+    for (size_t i = 0 ; i != __n ; ++i) __cnt += __src[i];
+    return __cnt;
 }
 
-/* Rshift word by word. */
-inline constexpr void
-word_rshift(vec2 __vec, size_t __n, size_t __shift) {
-    if (__shift == 0) return;
-    const auto [__dst, __src] = __vec;
-    const auto __offset = __shift / __WBits;
-    const auto __count  = div_ceil(__n) - __offset;
-    return word_copy<true>(__dst, __src + __offset, __count);
+inline bool none(const _Word_t *__src, size_t __n) {
+    for (size_t i = 0 ; i != __n ; ++i) if (__src[i] != 0) return false;
+    return true;
 }
 
-/* Lshift bits by bits. */
-inline constexpr void
-bits_lshift(vec2 __vec, size_t __n, size_t __shift) {
-    const auto [__div, __mod] = div_mod(__shift);
+inline bool all(const _Word_t *__src, size_t __n) {
+    for (size_t i = 0 ; i != __n ; ++i) if (~__src[i] != 0) return false;
+    return true;
+}
 
-    const auto __len = div_down(__n);
-    const auto __rev = rev_bits(__mod); // 64 - __mod
-    const auto __end = __vec.src;
+/**
+ * Fused shift kernels, 0 < __mod < 64.
+ * shl: from the top down, __dst[i] op= __src[i] << __mod | __src[i - 1] >> (64 - __mod).
+ * shr: from the bottom up, __dst[i] op= __src[i] >> __mod | __src[i + 1] << (64 - __mod).
+ * __src[-1] (shl) or __src[__n] (shr) must be readable. In place use is
+ * safe when __dst >= __src (shl) or __dst <= __src (shr).
+ */
+template <bool _And>
+inline constexpr void shl(_Word_t *__dst, const _Word_t *__src, size_t __n, size_t __mod) {
+    if (__n == 0) return;
+    auto __hi = __src[__n - 1]; // Carried over, one load per word.
+    for (size_t i = __n ; i-- != 0 ;) {
+        const auto __lo  = __src[i - 1];
+        const auto __val = __hi << __mod | __lo >> (__WBits - __mod);
+        __dst[i] = _And ? __dst[i] & __val : __dst[i] | __val;
+        __hi = __lo;
+    }
+}
 
-    auto [__dst, __src] = (__vec + __len) << __div;
+template <bool _And>
+inline constexpr void shr(_Word_t *__dst, const _Word_t *__src, size_t __n, size_t __mod) {
+    if (__n == 0) return;
+    auto __lo = __src[0];
+    for (size_t i = 0 ; i != __n ; ++i) {
+        const auto __hi  = __src[i + 1];
+        const auto __val = __lo >> __mod | __hi << (__WBits - __mod);
+        __dst[i] = _And ? __dst[i] & __val : __dst[i] | __val;
+        __lo = __hi;
+    }
+}
 
-    /* The last word may be unsafe. */
-    auto __pre = div_down(__n - __mod) == __len ? *__src : 0;
+inline void or_shl (_Word_t *__d, const _Word_t *__s, size_t __n, size_t __m) { shl <false> (__d, __s, __n, __m); }
+inline void and_shl(_Word_t *__d, const _Word_t *__s, size_t __n, size_t __m) { shl <true>  (__d, __s, __n, __m); }
+inline void or_shr (_Word_t *__d, const _Word_t *__s, size_t __n, size_t __m) { shr <false> (__d, __s, __n, __m); }
+inline void and_shr(_Word_t *__d, const _Word_t *__s, size_t __n, size_t __m) { shr <true>  (__d, __s, __n, __m); }
 
-    while (__src != __end) {
-        auto __cur = *--__src;
-        *__dst-- = __pre << __mod | __cur >> __rev;
-        __pre = __cur; // Update the previous word.
-    }
+/* Reduction kernels: nothing is written, (__lhs op __rhs) is only counted or tested. */
 
-    /* The first word must be safe. */
-    *__dst = __pre << __mod;
+template <reduce_op _Op>
+inline size_t count_of(const _Word_t *__lhs, const _Word_t *__rhs, size_t __n) {
+    size_t __cnt = 0;
+    for (size_t i = 0 ; i != __n ; ++i)
+        __cnt += std::popcount(reduce_word <_Op> (__lhs[i], __rhs[i]));
+    return __cnt;
+}
 
-    /* Validate those words in the front. */
-    return word_reset(__dst - __div, 0, __div);
+template <reduce_op _Op>
+inline bool none_of(const _Word_t *__lhs, const _Word_t *__rhs, size_t __n) {
+    for (size_t i = 0 ; i != __n ; ++i)
+        if (reduce_word <_Op> (__lhs[i], __rhs[i]) != 0) return false;
+    return true;
 }
 
-/* Lshift bits by bits. */
-inline constexpr void
-bits_rshift(vec2 __vec, size_t __n, size_t __shift) {
-    const auto [__div, __mod] = div_mod(__shift);
+/* __out[i] = count_of(__query, candidate i), candidates are __w words apart. */
+template <reduce_op _Op>
+inline void count_many(const _Word_t *__query, const _Word_t *__base,
+                       size_t __w, size_t __n, size_t *__out) {
+    for (size_t i = 0 ; i != __n ; ++i)
+        __out[i] = count_of <_Op> (__query, __base + i * __w, __w);
+}
 
-    const auto __len = div_down(__n);
-    const auto __rev = rev_bits(__mod); // 64 - __mod
-    const auto __end = __vec.dst + __len;
+} // namespace __scalar
 
-    auto [__dst, __src] = __vec >> __div;
-    /* The first word must be safe. */
-    auto __pre = *__src;
+#ifdef _DARK_BITSET_SIMD
 
-    while (__dst != __end) {
-        auto __cur = *++__src;
-        *__dst++ = __pre >> __mod | __cur << __rev;
-        __pre = __cur; // Update the previous word.
-    }
+/* AVX2 kernels, 4 words per step. */
+namespace __avx2 {
 
-    /* The last word may be unsafe. */
-    auto __cur = div_down(__n + __mod) == __len ? 0 : *++__src;
+using __v = __m256i;
 
-    /* Rely on the fact that the unused bit of src is filled with 0. */
-    *__dst = __pre >> __mod | __cur << __rev;
+[[__gnu__::__target__("avx2"), __gnu__::__always_inline__]]
+inline __v load(const _Word_t *__src) {
+    return _mm256_loadu_si256(reinterpret_cast <const __v *> (__src));
 }
 
-/* Perform left shift operation without any validation. */
-inline constexpr void
-do_lshift(vec2 __vec, size_t __n, size_t __shift) {
-    if (__shift % __WBits != 0)
-        return bits_lshift(__vec, __n, __shift);
-    else // __shift % CHAR_BIT == 0. Align to byte.
-        return word_lshift(__vec, __n, __shift);
+[[__gnu__::__target__("avx2"), __gnu__::__always_inline__]]
+inline void store(_Word_t *__dst, __v __val) {
+    _mm256_storeu_si256(reinterpret_cast <__v *> (__dst), __val);
 }
 
-/* Perform right shift operation with natural validation. */
-inline constexpr void
-do_rshift(vec2 __vec, size_t __n, size_t __shift) {
-    if (__shift % __WBits != 0)
-        return bits_rshift(__vec, __n, __shift);
-    else // __shift % CHAR_BIT == 0. Align to byte.
-        return word_rshift(__vec, __n, __shift);
+[[__gnu__::__target__("avx2")]]
+inline void do_and(_Word_t *__dst, const _Word_t *__src, size_t __n) {
+    size_t i = 0;
+    for (; i + 4 <= __n ; i += 4)
+        store(__dst + i, _mm256_and_si256(load(__dst + i), load(__src + i)));
+    return __scalar::do_and(__dst + i, __src + i, __n - i);
 }
 
+[[__gnu__::__target__("avx2")]]
+inline void do_or_(_Word_t *__dst, const _Word_t *__src, size_t __n) {
+    size_t i = 0;
+    for (; i + 4 <= __n ; i += 4)
+        store(__dst + i, _mm256_or_si256(load(__dst + i), load(__src + i)));
+    return __scalar::do_or_(__dst + i, __src + i, __n - i);
+}
 
-} // namespace __detail::__bitset
+[[__gnu__::__target__("avx2")]]
+inline void do_xor(_Word_t *__dst, const _Word_t *__src, size_t __n) {
+    size_t i = 0;
+    for (; i + 4 <= __n ; i += 4)
+        store(__dst + i, _mm256_xor_si256(load(__dst + i), load(__src + i)));
+    return __scalar::do_xor(__dst + i, __src + i, __n - i);
+}
 
+[[__gnu__::__target__("avx2")]]
+inline void do_not(_Word_t *__dst, size_t __n) {
+    const auto __ones = _mm256_set1_epi64x(-1);
+    size_t i = 0;
+    for (; i + 4 <= __n ; i += 4)
+        store(__dst + i, _mm256_xor_si256(load(__dst + i), __ones));
+    return __scalar::do_not(__dst + i, __n - i);
+}
 
-struct dynamic_bitset : private __detail::__bitset::dynamic_storage {
-  public:
-    using _Bitset   = dynamic_bitset;
-    using reference = __detail::__bitset::reference;
+/* Per-64-bit-lane popcount, nibble lookup (Mula et al.). */
+[[__gnu__::__target__("avx2"), __gnu__::__always_inline__]]
+inline __v popcount(__v __val) {
+    const auto __table = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const auto __low = _mm256_set1_epi8(0x0f);
+    const auto __lo  = _mm256_and_si256(__val, __low);
+    const auto __hi  = _mm256_and_si256(_mm256_srli_epi16(__val, 4), __low);
+    const auto __cnt = _mm256_add_epi8(
+        _mm256_shuffle_epi8(__table, __lo),
+        _mm256_shuffle_epi8(__table, __hi));
+    return _mm256_sad_epu8(__cnt, _mm256_setzero_si256());
+}
 
-    inline static constexpr size_t npos = -1;
+[[__gnu__::__target__("avx2"), __gnu__::__always_inline__]]
+inline size_t reduce(__v __val) {
+    const auto __lo = _mm256_castsi256_si128(__val);
+    const auto __hi = _mm256_extracti128_si256(__val, 1);
+    const auto __sum = _mm_add_epi64(__lo, __hi);
+    return _mm_cvtsi128_si64(__sum) + _mm_extract_epi64(__sum, 1);
+}
 
-  private:
-    using _Base_t = __detail::__bitset::dynamic_storage;
-    using _Word_t = __detail::__bitset::_Word_t;
+[[__gnu__::__target__("avx2")]]
+inline size_t count(const _Word_t *__src, size_t __n) {
+    auto __acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= __n ; i += 4)
+        __acc = _mm256_add_epi64(__acc, popcount(load(__src + i)));
+    return reduce(__acc) + __scalar::count(__src + i, __n - i);
+}
 
-    constexpr static _Word_t min(_Word_t __x, _Word_t __y) { return __x < __y ? __x : __y; }
-  public:
-    /* ctor and operator section. */
+[[__gnu__::__target__("avx2")]]
+inline bool none(const _Word_t *__src, size_t __n) {
+    size_t i = 0;
+    for (; i + 4 <= __n ; i += 4) {
+        const auto __val = load(__src + i);
+        if (!_mm256_testz_si256(__val, __val)) return false;
+    }
+    return __scalar::none(__src + i, __n - i);
+}
 
-    constexpr dynamic_bitset() = default;
-    constexpr ~dynamic_bitset() = default;
+[[__gnu__::__target__("avx2")]]
+inline bool all(const _Word_t *__src, size_t __n) {
+    const auto __ones = _mm256_set1_epi64x(-1);
+    size_t i = 0;
+    for (; i + 4 <= __n ; i += 4)
+        if (!_mm256_testc_si256(load(__src + i), __ones)) return false;
+    return __scalar::all(__src + i, __n - i);
+}
 
-    constexpr dynamic_bitset(const dynamic_bitset &) = default;
-    constexpr dynamic_bitset(dynamic_bitset &&) noexcept = default;
+/* Fused shift kernels, see __scalar::shl and __scalar::shr. */
+template <bool _And>
+[[__gnu__::__target__("avx2")]]
+inline void shl(_Word_t *__dst, const _Word_t *__src, size_t __n, size_t __mod) {
+    const auto __lc = _mm256_set1_epi64x(static_cast <long long> (__mod));
+    const auto __rc = _mm256_set1_epi64x(static_cast <long long> (__WBits - __mod));
+    for (; __n >= 4 ; __n -= 4) {
+        const auto __val = _mm256_or_si256(
+            _mm256_sllv_epi64(load(__src + __n - 4), __lc),
+            _mm256_srlv_epi64(load(__src + __n - 5), __rc));
+        const auto __old = load(__dst + __n - 4);
+        store(__dst + __n - 4, _And ? _mm256_and_si256(__old, __val) : _mm256_or_si256(__old, __val));
+    }
+    return __scalar::shl <_And> (__dst, __src, __n, __mod);
+}
 
-    constexpr dynamic_bitset &operator = (const dynamic_bitset &) = default;
-    constexpr dynamic_bitset &operator = (dynamic_bitset &&) noexcept = default;
+template <bool _And>
+[[__gnu__::__target__("avx2")]]
+inline void shr(_Word_t *__dst, const _Word_t *__src, size_t __n, size_t __mod) {
+    const auto __rc = _mm256_set1_epi64x(static_cast <long long> (__mod));
+    const auto __lc = _mm256_set1_epi64x(static_cast <long long> (__WBits - __mod));
+    size_t i = 0;
+    for (; i + 4 <= __n ; i += 4) {
+        const auto __val = _mm256_or_si256(
+            _mm256_srlv_epi64(load(__src + i), __rc),
+            _mm256_sllv_epi64(load(__src + i + 1), __lc));
+        const auto __old = load(__dst + i);
+        store(__dst + i, _And ? _mm256_and_si256(__old, __val) : _mm256_or_si256(__old, __val));
+    }
+    return __scalar::shr <_And> (__dst + i, __src + i, __n - i, __mod);
+}
 
-    constexpr dynamic_bitset(size_t __n) : _Base_t(__n, nullptr) {}
+inline void or_shl (_Word_t *__d, const _Word_t *__s, size_t __n, size_t __m) { shl <false> (__d, __s, __n, __m); }
+inline void and_shl(_Word_t *__d, const _Word_t *__s, size_t __n, size_t __m) { shl <true>  (__d, __s, __n, __m); }
+inline void or_shr (_Word_t *__d, const _Word_t *__s, size_t __n, size_t __m) { shr <false> (__d, __s, __n, __m); }
+inline void and_shr(_Word_t *__d, const _Word_t *__s, size_t __n, size_t __m) { shr <true>  (__d, __s, __n, __m); }
+
+template <reduce_op _Op>
+[[__gnu__::__target__("avx2"), __gnu__::__always_inline__]]
+inline __v reduce_vec(__v __lhs, __v __rhs) {
+    if constexpr (_Op == reduce_op::and_) return _mm256_and_si256(__lhs, __rhs);
+    if constexpr (_Op == reduce_op::or_)  return _mm256_or_si256(__lhs, __rhs);
+    if constexpr (_Op == reduce_op::xor_) return _mm256_xor_si256(__lhs, __rhs);
+    if constexpr (_Op == reduce_op::andn) return _mm256_andnot_si256(__rhs, __lhs);
+}
 
-    constexpr dynamic_bitset(size_t __n, bool __x) : _Base_t(__n) {
-        __detail::__bitset::word_reset(this->data(), __x, this->word_count());
-        if (__x) __detail::__bitset::validate(this->data(), length);
-    }
+/* Reduction kernels, see __scalar::count_of and friends. */
+template <reduce_op _Op>
+[[__gnu__::__target__("avx2")]]
+inline size_t count_of(const _Word_t *__lhs, const _Word_t *__rhs, size_t __n) {
+    auto __acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= __n ; i += 4)
+        __acc = _mm256_add_epi64(__acc,
+            popcount(reduce_vec <_Op> (load(__lhs + i), load(__rhs + i))));
+    return reduce(__acc) + __scalar::count_of <_Op> (__lhs + i, __rhs + i, __n - i);
+}
 
-    constexpr dynamic_bitset(std::string_view __str) : dynamic_bitset(__str.size()) {
-        length = __str.size();
-        for (size_t i = 0 ; i != length ; ++i)
-            if (__str[i] == '1') this->set(i);
+template <reduce_op _Op>
+[[__gnu__::__target__("avx2")]]
+inline bool none_of(const _Word_t *__lhs, const _Word_t *__rhs, size_t __n) {
+    size_t i = 0;
+    for (; i + 4 <= __n ; i += 4) {
+        const auto __val = reduce_vec <_Op> (load(__lhs + i), load(__rhs + i));
+        if (!_mm256_testz_si256(__val, __val)) return false;
     }
+    return __scalar::none_of <_Op> (__lhs + i, __rhs + i, __n - i);
+}
 
-    constexpr _Bitset &operator |= (const _Bitset &__rhs) {
-        const auto __min = this->min(length, __rhs.length);
-        __detail::__bitset::do_or_(this->data(), __rhs.data(), __min);
-        return *this;
-    }
+template <reduce_op _Op>
+[[__gnu__::__target__("avx2")]]
+inline void count_many(const _Word_t *__query, const _Word_t *__base,
+                       size_t __w, size_t __n, size_t *__out) {
+    for (size_t i = 0 ; i != __n ; ++i)
+        __out[i] = count_of <_Op> (__query, __base + i * __w, __w);
+}
 
-    constexpr _Bitset &operator &= (const _Bitset &__rhs) {
-        const auto __min = this->min(length, __rhs.length);
-        __detail::__bitset::do_and(this->data(), __rhs.data(), __min);
-        return *this;
-    }
+} // namespace __avx2
 
-    constexpr _Bitset &operator ^= (const _Bitset &__rhs) {
-        const auto __min = this->min(length, __rhs.length);
-        __detail::__bitset::do_xor(this->data(), __rhs.data(), __min);
-        return *this;
-    }
+/* AVX-512 kernels, 8 words per step, masked tail. */
+namespace __avx512 {
 
-    constexpr _Bitset &operator <<= (size_t __n) {
-        if (!length) return this->assign(__n, 0), *this;
-        length += __n;
+using __v = __m512i;
+using __m = __mmask8;
 
-        const auto __size = this->word_count();
-        const auto __capa = this->capacity();
-        const auto __head = this->data();
+#define _DARK_AVX512 __gnu__::__target__("avx512f,avx512vpopcntdq")
 
-        /* This is a nice estimation of next potential size.*/
-        /* It will be larger, but that too much bigger.     */
-        if (__capa < __size) this->realloc(__size + __capa);
+[[_DARK_AVX512, __gnu__::__always_inline__]]
+inline __m tail(size_t __n) { return static_cast <__m> ((1u << __n) - 1); }
 
-        const auto __data = this->data();
-        __detail::__bitset::do_lshift({__data, __head}, length, __n);
-        __detail::__bitset::validate(__data, length);
+[[_DARK_AVX512, __gnu__::__always_inline__]]
+inline __v load(const _Word_t *__src) { return _mm512_loadu_si512(__src); }
 
-        /* If realloc, deallocate the old memory. */
-        if (__head != __data) this->dealloc(__head, __capa);
-        return *this;
-    }
+[[_DARK_AVX512, __gnu__::__always_inline__]]
+inline __v load(const _Word_t *__src, __m __k) {
+    return _mm512_maskz_loadu_epi64(__k, __src);
+}
 
-    constexpr _Bitset &operator >>= (size_t __n) {
-        if (__n < length) {
-            length -= __n;
-            const auto __data = this->data();
-            __detail::__bitset::do_rshift({__data, __data}, length, __n);
-        } else this->clear();
-        return *this;
-    }
+/* Per-lane shifts. Zero-masked forms: the plain ones trip -Wmaybe-uninitialized on gcc 12. */
+[[_DARK_AVX512, __gnu__::__always_inline__]]
+inline __v sllv(__v __x, __v __c) { return _mm512_maskz_sllv_epi64(__m(-1), __x, __c); }
+
+[[_DARK_AVX512, __gnu__::__always_inline__]]
+inline __v srlv(__v __x, __v __c) { return _mm512_maskz_srlv_epi64(__m(-1), __x, __c); }
+
+[[_DARK_AVX512]]
+inline void do_and(_Word_t *__dst, const _Word_t *__src, size_t __n) {
+    size_t i = 0;
+    for (; i + 8 <= __n ; i += 8)
+        _mm512_storeu_si512(__dst + i,
+            _mm512_and_si512(load(__dst + i), load(__src + i)));
+    if (const auto __k = tail(__n - i))
+        _mm512_mask_storeu_epi64(__dst + i, __k,
+            _mm512_and_si512(load(__dst + i, __k), load(__src + i, __k)));
+}
 
-    constexpr _Bitset operator ~() const;
+[[_DARK_AVX512]]
+inline void do_or_(_Word_t *__dst, const _Word_t *__src, size_t __n) {
+    size_t i = 0;
+    for (; i + 8 <= __n ; i += 8)
+        _mm512_storeu_si512(__dst + i,
+            _mm512_or_si512(load(__dst + i), load(__src + i)));
+    if (const auto __k = tail(__n - i))
+        _mm512_mask_storeu_epi64(__dst + i, __k,
+            _mm512_or_si512(load(__dst + i, __k), load(__src + i, __k)));
+}
 
-  public:
-    /* Section of member functions that won't bring size changes. */
+[[_DARK_AVX512]]
+inline void do_xor(_Word_t *__dst, const _Word_t *__src, size_t __n) {
+    size_t i = 0;
+    for (; i + 8 <= __n ; i += 8)
+        _mm512_storeu_si512(__dst + i,
+            _mm512_xor_si512(load(__dst + i), load(__src + i)));
+    if (const auto __k = tail(__n - i))
+        _mm512_mask_storeu_epi64(__dst + i, __k,
+            _mm512_xor_si512(load(__dst + i, __k), load(__src + i, __k)));
+}
 
-    constexpr _Bitset &set() {
-        const auto __size = this->word_count();
-        __detail::__bitset::word_reset(this->data(), 1, __size);
-        __detail::__bitset::validate(this->data(), length);
-        return *this;
-    }
+[[_DARK_AVX512]]
+inline void do_not(_Word_t *__dst, size_t __n) {
+    const auto __ones = _mm512_set1_epi64(-1);
+    size_t i = 0;
+    for (; i + 8 <= __n ; i += 8)
+        _mm512_storeu_si512(__dst + i, _mm512_xor_si512(load(__dst + i), __ones));
+    if (const auto __k = tail(__n - i))
+        _mm512_mask_storeu_epi64(__dst + i, __k,
+            _mm512_xor_si512(load(__dst + i, __k), __ones));
+}
 
-    constexpr _Bitset &flip() {
-        const auto __size = this->word_count();
-        for (size_t i = 0 ; i != __size ; ++i)
-            this->data(i) = ~this->data(i);
-        __detail::__bitset::validate(this->data(), length);
-        return *this;
-    }
+[[_DARK_AVX512]]
+inline size_t count(const _Word_t *__src, size_t __n) {
+    auto __acc = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 8 <= __n ; i += 8)
+        __acc = _mm512_add_epi64(__acc, _mm512_popcnt_epi64(load(__src + i)));
+    if (const auto __k = tail(__n - i))
+        __acc = _mm512_add_epi64(__acc, _mm512_popcnt_epi64(load(__src + i, __k)));
+    _Word_t __sum[8]; /* Avoid reduce intrinsic, noisy in some headers. */
+    _mm512_storeu_si512(__sum, __acc);
+    return __scalar::sum(__sum, 8);
+}
 
-    constexpr _Bitset &reset() {
-        const auto __size = this->word_count();
-        __detail::__bitset::word_reset(this->data(), 0, __size);
-        return *this;
+[[_DARK_AVX512]]
+inline bool none(const _Word_t *__src, size_t __n) {
+    size_t i = 0;
+    for (; i + 8 <= __n ; i += 8) {
+        const auto __val = load(__src + i);
+        if (_mm512_test_epi64_mask(__val, __val)) return false;
     }
+    const auto __val = load(__src + i, tail(__n - i));
+    return _mm512_test_epi64_mask(__val, __val) == 0;
+}
 
-    /* Return whether there is any bit set to 1. */
-    constexpr bool any() const { return !this->none(); }
-    /* Return whether all bits are set to 1. */
-    constexpr bool all() const {
-        auto [__div, __mod] = __detail::__bitset::div_mod(length);
-        for (size_t i = 0 ; i != __div ; ++i)
-            if (~data(i) != 0) return false;
-        return data(__div) == __detail::__bitset::mask_low(__mod);
-    }
-    /* Return whether all bits are set to 0. */
-    constexpr bool none() const {
-        auto __top = this->word_count();
-        for (size_t i = 0 ; i != __top ; ++i)
-            if (data(i) != 0) return false;
-        return true;
+[[_DARK_AVX512]]
+inline bool all(const _Word_t *__src, size_t __n) {
+    const auto __ones = _mm512_set1_epi64(-1);
+    size_t i = 0;
+    for (; i + 8 <= __n ; i += 8)
+        if (_mm512_cmpneq_epi64_mask(load(__src + i), __ones)) return false;
+    const auto __k = tail(__n - i);
+    return _mm512_mask_cmpneq_epi64_mask(__k, load(__src + i, __k), __ones) == 0;
+}
+
+/* Fused shift kernels, see __scalar::shl and __scalar::shr. */
+template <bool _And>
+[[_DARK_AVX512]]
+inline void shl(_Word_t *__dst, const _Word_t *__src, size_t __n, size_t __mod) {
+    const auto __lc = _mm512_set1_epi64(static_cast <long long> (__mod));
+    const auto __rc = _mm512_set1_epi64(static_cast <long long> (__WBits - __mod));
+    for (; __n >= 8 ; __n -= 8) {
+        const auto __val = _mm512_or_si512(
+            sllv(load(__src + __n - 8), __lc),
+            srlv(load(__src + __n - 9), __rc));
+        const auto __old = load(__dst + __n - 8);
+        _mm512_storeu_si512(__dst + __n - 8, _And ? _mm512_and_si512(__old, __val) : _mm512_or_si512(__old, __val));
     }
+    return __scalar::shl <_And> (__dst, __src, __n, __mod);
+}
 
-    /* Return the number of bits set to 1. */
-    constexpr size_t count() const {
-        size_t __cnt = 0;
-        auto __top = this->word_count();
-        for (size_t i = 0 ; i != __top ; ++i)
-            __cnt += std::popcount(data(i));
-        return __cnt;
+template <bool _And>
+[[_DARK_AVX512]]
+inline void shr(_Word_t *__dst, const _Word_t *__src, size_t __n, size_t __mod) {
+    const auto __rc = _mm512_set1_epi64(static_cast <long long> (__mod));
+    const auto __lc = _mm512_set1_epi64(static_cast <long long> (__WBits - __mod));
+    size_t i = 0;
+    for (; i + 8 <= __n ; i += 8) {
+        const auto __val = _mm512_or_si512(
+            srlv(load(__src + i), __rc),
+            sllv(load(__src + i + 1), __lc));
+        const auto __old = load(__dst + i);
+        _mm512_storeu_si512(__dst + i, _And ? _mm512_and_si512(__old, __val) : _mm512_or_si512(__old, __val));
     }
+    return __scalar::shr <_And> (__dst + i, __src + i, __n - i, __mod);
+}
 
-    constexpr void set(size_t __n)       { (*this)[__n].set();     }
-    constexpr void reset(size_t __n)     { (*this)[__n].reset();   }
-    constexpr void flip(size_t __n)      { (*this)[__n].flip();    }
+inline void or_shl (_Word_t *__d, const _Word_t *__s, size_t __n, size_t __m) { shl <false> (__d, __s, __n, __m); }
+inline void and_shl(_Word_t *__d, const _Word_t *__s, size_t __n, size_t __m) { shl <true>  (__d, __s, __n, __m); }
+inline void or_shr (_Word_t *__d, const _Word_t *__s, size_t __n, size_t __m) { shr <false> (__d, __s, __n, __m); }
+inline void and_shr(_Word_t *__d, const _Word_t *__s, size_t __n, size_t __m) { shr <true>  (__d, __s, __n, __m); }
+
+template <reduce_op _Op>
+[[_DARK_AVX512, __gnu__::__always_inline__]]
+inline __v reduce_vec(__v __lhs, __v __rhs) {
+    if constexpr (_Op == reduce_op::and_) return _mm512_and_si512(__lhs, __rhs);
+    if constexpr (_Op == reduce_op::or_)  return _mm512_or_si512(__lhs, __rhs);
+    if constexpr (_Op == reduce_op::xor_) return _mm512_xor_si512(__lhs, __rhs);
+    /* Zero-masked form, as for sllv and srlv. */
+    if constexpr (_Op == reduce_op::andn) return _mm512_maskz_andnot_epi64(__m(-1), __rhs, __lhs);
+}
 
-    constexpr bool test(size_t __n) const {
-        auto [__div, __mod] = __detail::__bitset::div_mod(__n);
-        return (data(__div) >> __mod) & 1;
-    }
+/* Reduction kernels, see __scalar::count_of and friends. */
+template <reduce_op _Op>
+[[_DARK_AVX512, __gnu__::__always_inline__]]
+inline __v count_vec(const _Word_t *__lhs, const _Word_t *__rhs, size_t __n) {
+    auto __acc = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 8 <= __n ; i += 8)
+        __acc = _mm512_add_epi64(__acc,
+            _mm512_popcnt_epi64(reduce_vec <_Op> (load(__lhs + i), load(__rhs + i))));
+    if (const auto __k = tail(__n - i))
+        __acc = _mm512_add_epi64(__acc,
+            _mm512_popcnt_epi64(reduce_vec <_Op> (load(__lhs + i, __k), load(__rhs + i, __k))));
+    return __acc;
+}
 
-    constexpr size_t size()  const { return length; }
+template <reduce_op _Op>
+[[_DARK_AVX512]]
+inline size_t count_of(const _Word_t *__lhs, const _Word_t *__rhs, size_t __n) {
+    _Word_t __sum[8];
+    _mm512_storeu_si512(__sum, count_vec <_Op> (__lhs, __rhs, __n));
+    return __scalar::sum(__sum, 8);
+}
 
-    constexpr reference operator [] (size_t __n) {
+template <reduce_op _Op>
+[[_DARK_AVX512]]
+inline bool none_of(const _Word_t *__lhs, const _Word_t *__rhs, size_t __n) {
+    size_t i = 0;
+    for (; i + 8 <= __n ; i += 8) {
+        const auto __val = reduce_vec <_Op> (load(__lhs + i), load(__rhs + i));
+        if (_mm512_test_epi64_mask(__val, __val)) return false;
+    }
+    const auto __k = tail(__n - i);
+    const auto __val = reduce_vec <_Op> (load(__lhs + i, __k), load(__rhs + i, __k));
+    return _mm512_test_epi64_mask(__val, __val) == 0;
+}
+
+template <reduce_op _Op>
+[[_DARK_AVX512]]
+inline void count_many(const _Word_t *__query, const _Word_t *__base,
+                       size_t __w, size_t __n, size_t *__out) {
+    for (size_t i = 0 ; i != __n ; ++i) {
+        _Word_t __sum[8];
+        _mm512_storeu_si512(__sum, count_vec <_Op> (__query, __base + i * __w, __w));
+        __out[i] = __scalar::sum(__sum, 8);
+    }
+}
+
+#undef _DARK_AVX512
+
+} // namespace __avx512
+
+#endif // _DARK_BITSET_SIMD
+
+/* Table of bulk kernels for one instruction set. */
+struct kernel_table {
+    void   (*do_and)(_Word_t *, const _Word_t *, size_t);
+    void   (*do_or_)(_Word_t *, const _Word_t *, size_t);
+    void   (*do_xor)(_Word_t *, const _Word_t *, size_t);
+    void   (*do_not)(_Word_t *, size_t);
+    size_t (*count) (const _Word_t *, size_t);
+    bool   (*none)  (const _Word_t *, size_t);
+    bool   (*all)   (const _Word_t *, size_t);
+    void   (*or_shl) (_Word_t *, const _Word_t *, size_t, size_t);
+    void   (*and_shl)(_Word_t *, const _Word_t *, size_t, size_t);
+    void   (*or_shr) (_Word_t *, const _Word_t *, size_t, size_t);
+    void   (*and_shr)(_Word_t *, const _Word_t *, size_t, size_t);
+
+    /* Reductions, indexed by reduce_op. */
+    size_t (*count_of[4])  (const _Word_t *, const _Word_t *, size_t);
+    bool   (*none_of[4])   (const _Word_t *, const _Word_t *, size_t);
+    void   (*count_many[4])(const _Word_t *, const _Word_t *, size_t, size_t, size_t *);
+};
+
+#define _DARK_REDUCE(ns, fn) {                          \
+    ns::fn <reduce_op::and_>, ns::fn <reduce_op::or_>,  \
+    ns::fn <reduce_op::xor_>, ns::fn <reduce_op::andn>  \
+}
+
+#define _DARK_KERNEL(ns) kernel_table {                 \
+    ns::do_and, ns::do_or_, ns::do_xor, ns::do_not,     \
+    ns::count,  ns::none,   ns::all,                    \
+    ns::or_shl, ns::and_shl, ns::or_shr, ns::and_shr,   \
+    _DARK_REDUCE(ns, count_of),                         \
+    _DARK_REDUCE(ns, none_of),                          \
+    _DARK_REDUCE(ns, count_many)                        \
+}
+
+inline constexpr kernel_table scalar_kernel = _DARK_KERNEL(__scalar);
+#ifdef _DARK_BITSET_SIMD
+inline constexpr kernel_table avx2_kernel   = _DARK_KERNEL(__avx2);
+inline constexpr kernel_table avx512_kernel = _DARK_KERNEL(__avx512);
+#endif // _DARK_BITSET_SIMD
+
+#undef _DARK_KERNEL
+#undef _DARK_REDUCE
+
+/* Pick the widest instruction set supported by current cpu. */
+inline const kernel_table &select_kernel() {
+#ifdef _DARK_BITSET_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512vpopcntdq"))
+        return avx512_kernel;
+    if (__builtin_cpu_supports("avx2"))
+        return avx2_kernel;
+#endif // _DARK_BITSET_SIMD
+    return scalar_kernel;
+}
+
+/* Kernels chosen once, on first use. */
+inline const kernel_table &kernel() {
+    static const kernel_table &__table = select_kernel();
+    return __table;
+}
+
+/* Below this number of words, inline scalar loop beats an indirect call. */
+inline constexpr size_t __SimdMin = 8;
+
+inline constexpr void
+do_and(_Word_t *__dst, const _Word_t *__rhs, size_t __n) {
+    const auto [__div, __mod] = div_mod(__n);
+    if (std::is_constant_evaluated() || __div < __SimdMin) {
+        for (size_t i = 0; i != __div; ++i)
+            __dst[i] &= __rhs[i];
+    } else {
+        kernel().do_and(__dst, __rhs, __div);
+    }
+    if (__mod != 0)
+        __dst[__div] &= __rhs[__div] | mask_top(__mod);
+}
+
+inline constexpr void
+do_or_(_Word_t *__dst, const _Word_t *__rhs, size_t __n) {
+    const auto [__div, __mod] = div_mod(__n);
+    if (std::is_constant_evaluated() || __div < __SimdMin) {
+        for (size_t i = 0; i != __div; ++i)
+            __dst[i] |= __rhs[i];
+    } else {
+        kernel().do_or_(__dst, __rhs, __div);
+    }
+    if (__mod != 0)
+        __dst[__div] |= __rhs[__div] & mask_low(__mod);
+}
+
+inline constexpr void
+do_xor(_Word_t *__dst, const _Word_t *__rhs, size_t __n) {
+    const auto [__div, __mod] = div_mod(__n);
+    if (std::is_constant_evaluated() || __div < __SimdMin) {
+        for (size_t i = 0; i != __div; ++i)
+            __dst[i] ^= __rhs[i];
+    } else {
+        kernel().do_xor(__dst, __rhs, __div);
+    }
+    if (__mod != 0)
+        __dst[__div] ^= __rhs[__div] & mask_low(__mod);
+}
+
+/* Flip __n words. */
+inline constexpr void
+do_not(_Word_t *__dst, size_t __n) {
+    if (std::is_constant_evaluated() || __n < __SimdMin) {
+        for (size_t i = 0 ; i != __n ; ++i)
+            __dst[i] = ~__dst[i];
+    } else {
+        kernel().do_not(__dst, __n);
+    }
+}
+
+/* Count 1 bits in __n words. */
+inline constexpr size_t
+do_count(const _Word_t *__src, size_t __n) {
+    if (std::is_constant_evaluated() || __n < __SimdMin) {
+        size_t __cnt = 0;
+        for (size_t i = 0 ; i != __n ; ++i)
+            __cnt += std::popcount(__src[i]);
+        return __cnt;
+    } else {
+        return kernel().count(__src, __n);
+    }
+}
+
+/* Return whether __n words are all 0. */
+inline constexpr bool
+is_none(const _Word_t *__src, size_t __n) {
+    if (std::is_constant_evaluated() || __n < __SimdMin) {
+        for (size_t i = 0 ; i != __n ; ++i)
+            if (__src[i] != 0) return false;
+        return true;
+    } else {
+        return kernel().none(__src, __n);
+    }
+}
+
+/* Return whether first __n bits are all 1. */
+inline constexpr bool
+is_all(const _Word_t *__src, size_t __n) {
+    const auto [__div, __mod] = div_mod(__n);
+    if (std::is_constant_evaluated() || __div < __SimdMin) {
+        for (size_t i = 0 ; i != __div ; ++i)
+            if (~__src[i] != 0) return false;
+    } else if (!kernel().all(__src, __div)) {
+        return false;
+    }
+    return __mod == 0 || __src[__div] == mask_low(__mod);
+}
+
+/* Count 1 bits of (__lhs op __rhs) over __n words, without building it. */
+template <reduce_op _Op>
+inline constexpr size_t
+count_of(const _Word_t *__lhs, const _Word_t *__rhs, size_t __n) {
+    if (std::is_constant_evaluated() || __n < __SimdMin) {
+        size_t __cnt = 0;
+        for (size_t i = 0 ; i != __n ; ++i)
+            __cnt += std::popcount(reduce_word <_Op> (__lhs[i], __rhs[i]));
+        return __cnt;
+    } else {
+        return kernel().count_of[size_t(_Op)](__lhs, __rhs, __n);
+    }
+}
+
+/* Return whether (__lhs op __rhs) is all 0 over __n words. */
+template <reduce_op _Op>
+inline constexpr bool
+none_of(const _Word_t *__lhs, const _Word_t *__rhs, size_t __n) {
+    if (std::is_constant_evaluated() || __n < __SimdMin) {
+        for (size_t i = 0 ; i != __n ; ++i)
+            if (reduce_word <_Op> (__lhs[i], __rhs[i]) != 0) return false;
+        return true;
+    } else {
+        return kernel().none_of[size_t(_Op)](__lhs, __rhs, __n);
+    }
+}
+
+/**
+ * __out[i] = count_of(__query, candidate i) for __n candidates of __w
+ * words each, stored back to back from __base. One kernel call for the
+ * whole batch, so short bitsets pay no per-pair dispatch.
+ */
+template <reduce_op _Op>
+inline void
+count_many(const _Word_t *__query, const _Word_t *__base,
+           size_t __w, size_t __n, size_t *__out) {
+    kernel().count_many[size_t(_Op)](__query, __base, __w, __n, __out);
+}
+
+/* Hash of __n words and a length, so that equal bitsets hash equal. */
+inline constexpr size_t
+hash_words(const _Word_t *__src, size_t __n, size_t __len) {
+    constexpr _Word_t __mul = 0x9e3779b97f4a7c15; // 2^64 / golden ratio
+    _Word_t __h = __len * __mul;
+    for (size_t i = 0 ; i != __n ; ++i) {
+        __h = (__h ^ __src[i]) * __mul;
+        __h ^= __h >> 32;
+    }
+    return __h;
+}
+
+/* Return the index of the 1 bit at or after __pos, or -1 if none. */
+inline constexpr size_t
+find_next(const _Word_t *__src, size_t __n, size_t __pos) {
+    if (__pos >= __n) return -1;
+    auto [__div, __mod] = div_mod(__pos);
+    const auto __top = div_ceil(__n);
+    auto __word = __src[__div] & mask_top(__mod);
+    while (__word == 0)
+        if (++__div == __top) return -1;
+        else __word = __src[__div];
+    return __div * __WBits + std::countr_zero(__word);
+}
+
+/* Return the index of the 1 bit at or before __pos, or -1 if none. */
+inline constexpr size_t
+find_prev(const _Word_t *__src, size_t __n, size_t __pos) {
+    if (__n == 0) return -1;
+    if (__pos >= __n) __pos = __n - 1;
+    auto [__div, __mod] = div_mod(__pos);
+    auto __word = __src[__div] & (~_Word_t{0} >> (__WBits - 1 - __mod));
+    while (__word == 0)
+        if (__div-- == 0) return -1;
+        else __word = __src[__div];
+    return __div * __WBits + (__WBits - 1 - std::countl_zero(__word));
+}
+
+/**
+ * Write indices of all 1 bits within __n words into __out.
+ * Zero words are skipped, and bits are unrolled by 4 without
+ * testing each one. Return the number of indices written.
+ */
+inline constexpr size_t
+extract_indices(uint32_t *__out, const _Word_t *__src, size_t __n) {
+    const auto __beg = __out;
+    for (size_t i = 0 ; i != __n ; ++i) {
+        auto __word = __src[i];
+        if (__word == 0) continue;
+        const auto __base = static_cast <uint32_t> (i * __WBits);
+        const auto __cnt  = static_cast <size_t> (std::popcount(__word));
+        const auto __end  = __out + __cnt;
+        while (__end - __out >= 4) {
+            __out[0] = __base + std::countr_zero(__word); __word &= __word - 1;
+            __out[1] = __base + std::countr_zero(__word); __word &= __word - 1;
+            __out[2] = __base + std::countr_zero(__word); __word &= __word - 1;
+            __out[3] = __base + std::countr_zero(__word); __word &= __word - 1;
+            __out += 4;
+        }
+        while (__out != __end) {
+            *__out++ = __base + std::countr_zero(__word); __word &= __word - 1;
+        }
+    }
+    return __out - __beg;
+}
+
+/* Mask of bits used in the last word of a __n-bit prefix, __n > 0. */
+inline constexpr _Word_t mask_end(size_t __n) {
+    return ~_Word_t{0} >> (-__n % __WBits);
+}
+
+/* Set (or reset) the bits of __mask in __word. */
+inline constexpr void word_apply(_Word_t &__word, _Word_t __mask, bool __val) {
+    __word = __val ? __word | __mask : __word & ~__mask;
+}
+
+/**
+ * Range helpers on [__l, __r). The first and last words are masked,
+ * and whole words in between go through the bulk kernels.
+ */
+
+/* Set bits in [__l, __r) to __val. */
+inline constexpr void
+range_reset(_Word_t *__dst, size_t __l, size_t __r, bool __val) {
+    if (__l >= __r) return;
+    const auto __ld   = __l / __WBits;
+    const auto __rd   = div_down(__r);
+    const auto __head = mask_top(__l % __WBits);
+    const auto __tail = mask_end(__r);
+    if (__ld == __rd) return word_apply(__dst[__ld], __head & __tail, __val);
+    word_apply(__dst[__ld], __head, __val);
+    word_reset(__dst + __ld + 1, __val, __rd - __ld - 1);
+    word_apply(__dst[__rd], __tail, __val);
+}
+
+/* Flip bits in [__l, __r). */
+inline constexpr void
+range_flip(_Word_t *__dst, size_t __l, size_t __r) {
+    if (__l >= __r) return;
+    const auto __ld   = __l / __WBits;
+    const auto __rd   = div_down(__r);
+    const auto __head = mask_top(__l % __WBits);
+    const auto __tail = mask_end(__r);
+    if (__ld == __rd) { __dst[__ld] ^= __head & __tail; return; }
+    __dst[__ld] ^= __head;
+    do_not(__dst + __ld + 1, __rd - __ld - 1);
+    __dst[__rd] ^= __tail;
+}
+
+/* Count 1 bits in [__l, __r). */
+inline constexpr size_t
+range_count(const _Word_t *__src, size_t __l, size_t __r) {
+    if (__l >= __r) return 0;
+    const auto __ld   = __l / __WBits;
+    const auto __rd   = div_down(__r);
+    const auto __head = mask_top(__l % __WBits);
+    const auto __tail = mask_end(__r);
+    if (__ld == __rd) return std::popcount(__src[__ld] & __head & __tail);
+    return std::popcount(__src[__ld] & __head)
+         + do_count(__src + __ld + 1, __rd - __ld - 1)
+         + std::popcount(__src[__rd] & __tail);
+}
+
+/* Return whether all bits in [__l, __r) are 0. */
+inline constexpr bool
+range_none(const _Word_t *__src, size_t __l, size_t __r) {
+    if (__l >= __r) return true;
+    const auto __ld   = __l / __WBits;
+    const auto __rd   = div_down(__r);
+    const auto __head = mask_top(__l % __WBits);
+    const auto __tail = mask_end(__r);
+    if (__ld == __rd) return (__src[__ld] & __head & __tail) == 0;
+    return (__src[__ld] & __head) == 0
+        && is_none(__src + __ld + 1, __rd - __ld - 1)
+        && (__src[__rd] & __tail) == 0;
+}
+
+/* Return the index of the first 1 bit in [__l, __r), or -1 if none. */
+inline constexpr size_t
+range_find(const _Word_t *__src, size_t __l, size_t __r) {
+    if (__l >= __r) return -1;
+    auto __div = __l / __WBits;
+    const auto __rd = div_down(__r);
+    auto __word = __src[__div] & mask_top(__l % __WBits);
+    for (;;) {
+        if (__div == __rd) __word &= mask_end(__r);
+        if (__word != 0) return __div * __WBits + std::countr_zero(__word);
+        if (__div++ == __rd) return -1;
+        __word = __src[__div];
+    }
+}
+
+/* Read __n (<= 64) bits starting at bit __pos, into the low bits. */
+inline constexpr _Word_t
+read_window(const _Word_t *__src, size_t __pos, size_t __n) {
+    const auto [__div, __mod] = div_mod(__pos);
+    auto __word = __src[__div] >> __mod;
+    if (__mod + __n > __WBits) // Only touch the next word when needed.
+        __word |= __src[__div + 1] << rev_bits(__mod);
+    return __word & mask_end(__n);
+}
+
+/* Copy __n bits within one destination word. */
+inline constexpr void
+copy_chunk(_Word_t *__dst, size_t __dpos, const _Word_t *__src, size_t __spos, size_t __n) {
+    const auto [__div, __mod] = div_mod(__dpos);
+    const auto __mask = mask_end(__n) << __mod;
+    const auto __word = read_window(__src, __spos, __n) << __mod;
+    __dst[__div] = (__dst[__div] & ~__mask) | __word;
+}
+
+/**
+ * Copy __n bits from __src at __spos to __dst at __dpos.
+ * Each step writes one destination word, reading the source through
+ * an unaligned window as in bits_lshift/bits_rshift. Overlapping
+ * ranges in the same array are handled like memmove.
+ */
+inline constexpr void
+copy_range(_Word_t *__dst, size_t __dpos, const _Word_t *__src, size_t __spos, size_t __n) {
+    if (__n == 0) return;
+    const bool __back = __dst == __src && __spos < __dpos && __dpos < __spos + __n;
+    if (!__back) {
+        while (__n != 0) {
+            const auto __cnt = std::min(__n, __WBits - __dpos % __WBits);
+            copy_chunk(__dst, __dpos, __src, __spos, __cnt);
+            __dpos += __cnt; __spos += __cnt; __n -= __cnt;
+        }
+    } else {
+        while (__n != 0) {
+            const auto __mod = (__dpos + __n) % __WBits;
+            const auto __cnt = std::min(__n, __mod ? __mod : __WBits);
+            __n -= __cnt;
+            copy_chunk(__dst, __dpos + __n, __src, __spos + __n, __cnt);
+        }
+    }
+}
+
+/**
+ * Text conversion. Character i of binary text is bit i, and hex
+ * digit i holds bits [4i, 4i + 4), lowest bit in the lowest place.
+ * Scalar code works on 8 characters at once (SWAR). With SSE2, a
+ * whole word is converted in a few vector instructions.
+ */
+namespace __text {
+
+/* Repeat a byte 8 times. */
+inline constexpr uint64_t splat(uint8_t __c) { return uint64_t{0x0101010101010101} * __c; }
+
+/* Load 8 characters as one little-endian word. */
+inline constexpr uint64_t load8(const char *__src) {
+    if (std::is_constant_evaluated()) {
+        uint64_t __ret = 0;
+        for (size_t i = 0 ; i != 8 ; ++i)
+            __ret |= uint64_t(uint8_t(__src[i])) << (i * 8);
+        return __ret;
+    }
+    uint64_t __ret;
+    std::memcpy(&__ret, __src, 8);
+    return __ret;
+}
+
+inline constexpr void store8(char *__dst, uint64_t __val) {
+    if (std::is_constant_evaluated()) {
+        for (size_t i = 0 ; i != 8 ; ++i) __dst[i] = char(__val >> (i * 8));
+    } else {
+        std::memcpy(__dst, &__val, 8);
+    }
+}
+
+/* 8 characters to 8 bits. Clear __ok if any is not '0' or '1'. */
+inline constexpr _Word_t parse8(const char *__src, bool &__ok) {
+    const auto __x = load8(__src);
+    const auto __y = __x ^ splat('1');   // Zero bytes are '1'.
+    const auto __t = ((__y & splat(0x7f)) + splat(0x7f)) | __y;
+    const auto __one = (~__t & splat(0x80)) >> 7;
+    __ok &= ((__x ^ splat('0')) & splat(0xfe)) == 0;
+    return (__one * 0x0102040810204080) >> 56; // Gather low bit of each byte.
+}
+
+/* 8 bits to 8 characters. */
+inline constexpr void format8(char *__dst, _Word_t __bits) {
+    const auto __x = (__bits & 0xff) * splat(1) & 0x8040201008040201;
+    store8(__dst, (((__x + splat(0x7f)) >> 7) & splat(1)) | splat('0'));
+}
+
+/* Value of a hex digit, or 16 if invalid. */
+inline constexpr unsigned hex_value(char __c) {
+    if (__c >= '0' && __c <= '9') return __c - '0';
+    if (__c >= 'a' && __c <= 'f') return __c - 'a' + 10;
+    if (__c >= 'A' && __c <= 'F') return __c - 'A' + 10;
+    return 16;
+}
+
+inline constexpr char hex_digit(_Word_t __n) { return "0123456789abcdef"[__n & 15]; }
+
+/* Parse __n (<= 64) binary characters into one word. */
+inline constexpr _Word_t parse_bin(const char *__src, size_t __n, bool &__ok) {
+    _Word_t __word = 0;
+    size_t i = 0;
+    for (; i + 8 <= __n ; i += 8) __word |= parse8(__src + i, __ok) << i;
+    for (; i != __n ; ++i) {
+        __ok &= __src[i] == '0' || __src[i] == '1';
+        __word |= _Word_t(__src[i] == '1') << i;
+    }
+    return __word;
+}
+
+/* Format the low __n (<= 64) bits of a word as binary characters. */
+inline constexpr void format_bin(char *__dst, _Word_t __word, size_t __n) {
+    size_t i = 0;
+    for (; i + 8 <= __n ; i += 8) format8(__dst + i, __word >> i);
+    for (; i != __n ; ++i) __dst[i] = char('0' + ((__word >> i) & 1));
+}
+
+/* Parse __n (<= 16) hex digits into one word. */
+inline constexpr _Word_t parse_hex(const char *__src, size_t __n, bool &__ok) {
+    _Word_t __word = 0;
+    for (size_t i = 0 ; i != __n ; ++i) {
+        const auto __val = hex_value(__src[i]);
+        __ok &= __val < 16;
+        __word |= _Word_t(__val & 15) << (i * 4);
+    }
+    return __word;
+}
+
+/* Format the low __n (<= 16) nibbles of a word as hex digits. */
+inline constexpr void format_hex(char *__dst, _Word_t __word, size_t __n) {
+    for (size_t i = 0 ; i != __n ; ++i) __dst[i] = hex_digit(__word >> (i * 4));
+}
+
+/* The hex kernels move words with _mm_cvtsi64_si128, which is x86-64 only. */
+#if defined(_DARK_BITSET_SIMD) && defined(__SSE2__) && defined(__x86_64__)
+#define _DARK_BITSET_SSE2
+
+/* Parse 64 binary characters. */
+inline _Word_t sse2_parse_bin(const char *__src, bool &__ok) {
+    const auto __zero = _mm_set1_epi8('0');
+    const auto __one  = _mm_set1_epi8('1');
+    _Word_t __word = 0;
+    unsigned __good = 0xffff;
+    for (size_t i = 0 ; i != 4 ; ++i) {
+        const auto __v = _mm_loadu_si128(reinterpret_cast <const __m128i *> (__src + i * 16));
+        const auto __is1 = _mm_cmpeq_epi8(__v, __one);
+        const auto __is0 = _mm_cmpeq_epi8(__v, __zero);
+        __word |= _Word_t(unsigned(_mm_movemask_epi8(__is1))) << (i * 16);
+        __good &= unsigned(_mm_movemask_epi8(_mm_or_si128(__is0, __is1)));
+    }
+    __ok &= __good == 0xffff;
+    return __word;
+}
+
+/* Format 64 bits as binary characters. */
+inline void sse2_format_bin(char *__dst, _Word_t __word) {
+    const auto __mask = _mm_set1_epi64x(0x8040201008040201);
+    const auto __zero = _mm_set1_epi8('0');
+    for (size_t i = 0 ; i != 4 ; ++i) {
+        /* Byte j gets byte j / 8 of the 16 bits. */
+        auto __x = _mm_cvtsi32_si128(int((__word >> (i * 16)) & 0xffff));
+        __x = _mm_unpacklo_epi8(__x, __x);
+        __x = _mm_unpacklo_epi16(__x, __x);
+        __x = _mm_unpacklo_epi32(__x, __x);
+        const auto __set = _mm_cmpeq_epi8(_mm_and_si128(__x, __mask), __mask);
+        _mm_storeu_si128(reinterpret_cast <__m128i *> (__dst + i * 16), _mm_sub_epi8(__zero, __set));
+    }
+}
+
+/* Whether signed bytes of __v are in [0, __n). */
+inline __m128i sse2_in_range(__m128i __v, char __n) {
+    return _mm_and_si128(_mm_cmpgt_epi8(__v, _mm_set1_epi8(-1)), _mm_cmplt_epi8(__v, _mm_set1_epi8(__n)));
+}
+
+/* Parse 16 hex digits. */
+inline _Word_t sse2_parse_hex(const char *__src, bool &__ok) {
+    const auto __v = _mm_loadu_si128(reinterpret_cast <const __m128i *> (__src));
+    const auto __d = _mm_sub_epi8(__v, _mm_set1_epi8('0'));
+    const auto __a = _mm_sub_epi8(_mm_or_si128(__v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    const auto __is_d = sse2_in_range(__d, 10);
+    const auto __is_a = sse2_in_range(__a, 6);
+    __ok &= _mm_movemask_epi8(_mm_or_si128(__is_d, __is_a)) == 0xffff;
+
+    const auto __val = _mm_or_si128(_mm_and_si128(__is_d, __d),
+        _mm_and_si128(__is_a, _mm_add_epi8(__a, _mm_set1_epi8(10))));
+    /* Join digit pairs into bytes: even digit low, odd digit high. */
+    const auto __pair = _mm_or_si128(
+        _mm_and_si128(__val, _mm_set1_epi16(0x000f)),
+        _mm_and_si128(_mm_srli_epi16(__val, 4), _mm_set1_epi16(0x00f0)));
+    return _Word_t(_mm_cvtsi128_si64(_mm_packus_epi16(__pair, __pair)));
+}
+
+/* Format 64 bits as 16 hex digits. */
+inline void sse2_format_hex(char *__dst, _Word_t __word) {
+    const auto __low = _mm_set1_epi8(0x0f);
+    const auto __x   = _mm_cvtsi64_si128(static_cast <long long> (__word));
+    const auto __lo  = _mm_and_si128(__x, __low);
+    const auto __hi  = _mm_and_si128(_mm_srli_epi16(__x, 4), __low);
+    const auto __n   = _mm_unpacklo_epi8(__lo, __hi);
+    const auto __gap = _mm_and_si128(_mm_cmpgt_epi8(__n, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10));
+    const auto __c   = _mm_add_epi8(_mm_add_epi8(__n, _mm_set1_epi8('0')), __gap);
+    _mm_storeu_si128(reinterpret_cast <__m128i *> (__dst), __c);
+}
+
+#endif // SSE2
+
+} // namespace __text
+
+/**
+ * Parse __n binary characters into div_ceil(__n) words.
+ * Any character other than '1' is read as 0.
+ * Return whether all characters are '0' or '1'.
+ */
+inline constexpr bool
+parse_bin(_Word_t *__dst, const char *__src, size_t __n) {
+    const auto [__div, __mod] = div_mod(__n);
+    bool __ok = true;
+    for (size_t i = 0 ; i != __div ; ++i) {
+#ifdef _DARK_BITSET_SSE2
+        if (!std::is_constant_evaluated()) {
+            __dst[i] = __text::sse2_parse_bin(__src + i * __WBits, __ok);
+            continue;
+        }
+#endif
+        __dst[i] = __text::parse_bin(__src + i * __WBits, __WBits, __ok);
+    }
+    if (__mod != 0) __dst[__div] = __text::parse_bin(__src + __div * __WBits, __mod, __ok);
+    return __ok;
+}
+
+/**
+ * Parse __n hex digits into the words covering 4 * __n bits.
+ * Return whether all characters are hex digits.
+ */
+inline constexpr bool
+parse_hex(_Word_t *__dst, const char *__src, size_t __n) {
+    constexpr size_t __Digits = __WBits / 4;
+    const auto __div = __n / __Digits;
+    const auto __mod = __n % __Digits;
+    bool __ok = true;
+    for (size_t i = 0 ; i != __div ; ++i) {
+#ifdef _DARK_BITSET_SSE2
+        if (!std::is_constant_evaluated()) {
+            __dst[i] = __text::sse2_parse_hex(__src + i * __Digits, __ok);
+            continue;
+        }
+#endif
+        __dst[i] = __text::parse_hex(__src + i * __Digits, __Digits, __ok);
+    }
+    if (__mod != 0) __dst[__div] = __text::parse_hex(__src + __div * __Digits, __mod, __ok);
+    return __ok;
+}
+
+/* Write bits [__pos, __pos + __n) as binary characters. */
+inline constexpr void
+format_bin(char *__dst, const _Word_t *__src, size_t __pos, size_t __n) {
+    for (; __n >= __WBits ; __n -= __WBits, __pos += __WBits, __dst += __WBits) {
+        const auto __word = read_window(__src, __pos, __WBits);
+#ifdef _DARK_BITSET_SSE2
+        if (!std::is_constant_evaluated()) {
+            __text::sse2_format_bin(__dst, __word);
+            continue;
+        }
+#endif
+        __text::format_bin(__dst, __word, __WBits);
+    }
+    if (__n != 0) __text::format_bin(__dst, read_window(__src, __pos, __n), __n);
+}
+
+/**
+ * Write __n hex digits for bits [__pos, __pos + 4 * __n) of a bitset
+ * of __size bits. Bits at or past __size are written as 0.
+ */
+inline constexpr void
+format_hex(char *__dst, const _Word_t *__src, size_t __size, size_t __pos, size_t __n) {
+    constexpr size_t __Digits = __WBits / 4;
+    if (const auto __full = (__size - __pos) / 4 ; __n > __full) {
+        /* The last digit is partial, so never read past the last word. */
+        __dst[__full] = __text::hex_digit(read_window(__src, __pos + __full * 4, __size - __pos - __full * 4));
+        __n = __full;
+    }
+    for (; __n >= __Digits ; __n -= __Digits, __pos += __WBits, __dst += __Digits) {
+        const auto __word = read_window(__src, __pos, __WBits);
+#ifdef _DARK_BITSET_SSE2
+        if (!std::is_constant_evaluated()) {
+            __text::sse2_format_hex(__dst, __word);
+            continue;
+        }
+#endif
+        __text::format_hex(__dst, __word, __Digits);
+    }
+    if (__n != 0) __text::format_hex(__dst, read_window(__src, __pos, __n * 4), __n);
+}
+
+/* Forward iterator over indices of 1 bits. */
+struct one_iterator {
+  private:
+    const _Word_t * ptr;    // Pointer to the first word
+    size_t          pos;    // Index of current word
+    size_t          top;    // Number of words
+    _Word_t         cur;    // Bits not visited in current word
+
+    /* Move to the next non-zero word if current one is exhausted. */
+    constexpr void skip() {
+        while (cur == 0 && ++pos != top) cur = ptr[pos];
+    }
+
+  public:
+    using value_type        = size_t;
+    using difference_type   = ptrdiff_t;
+
+    constexpr one_iterator() noexcept : ptr(), pos(), top(), cur() {}
+    constexpr one_iterator(const _Word_t *__ptr, size_t __n)
+    noexcept : ptr(__ptr), pos(0), top(__n), cur(__n ? *__ptr : 0) {
+        if (top != 0) this->skip();
+    }
+
+    constexpr size_t operator *() const {
+        return pos * __WBits + std::countr_zero(cur);
+    }
+
+    constexpr one_iterator &operator ++() {
+        cur &= cur - 1;
+        this->skip();
+        return *this;
+    }
+    constexpr one_iterator operator ++(int) {
+        auto __tmp = *this; ++*this; return __tmp;
+    }
+
+    constexpr bool operator == (std::default_sentinel_t) const {
+        return pos == top;
+    }
+    constexpr bool operator == (const one_iterator &__rhs) const {
+        return pos == __rhs.pos && cur == __rhs.cur;
+    }
+};
+
+/* Range of indices of 1 bits, used in range-for. */
+struct one_range {
+    const _Word_t * ptr;    // Pointer to the first word
+    size_t          len;    // Number of words
+
+    constexpr auto begin() const { return one_iterator(ptr, len); }
+    constexpr auto end()   const { return std::default_sentinel; }
+};
+
+/**
+ * Lazy bitset expressions.
+ * A node yields its __n-th word through word(__n), so a whole
+ * expression is evaluated in one pass, with no temporaries.
+ */
+template <typename _Tp>
+concept bit_expr = requires (const _Tp &__e, size_t __n) {
+    { __e.word(__n) } -> std::same_as <_Word_t>;
+    { __e.size() }    -> std::same_as <size_t>;
+};
+
+/* Reductions shared by all expression nodes. */
+template <typename _Expr>
+struct expr_base {
+  private:
+    constexpr const _Expr &self() const { return static_cast <const _Expr &> (*this); }
+
+  public:
+    /* Return the number of bits set to 1. */
+    constexpr size_t count() const {
+        const auto [__div, __mod] = div_mod(self().size());
+        size_t __cnt = 0;
+        for (size_t i = 0 ; i != __div ; ++i)
+            __cnt += std::popcount(self().word(i));
+        if (__mod != 0)
+            __cnt += std::popcount(self().word(__div) & mask_low(__mod));
+        return __cnt;
+    }
+
+    /* Return whether all bits are set to 0. */
+    constexpr bool none() const {
+        const auto [__div, __mod] = div_mod(self().size());
+        for (size_t i = 0 ; i != __div ; ++i)
+            if (self().word(i) != 0) return false;
+        return __mod == 0 || (self().word(__div) & mask_low(__mod)) == 0;
+    }
+
+    /* Return whether there is any bit set to 1. */
+    constexpr bool any() const { return !this->none(); }
+
+    /* Return whether all bits are set to 1. */
+    constexpr bool all() const {
+        const auto [__div, __mod] = div_mod(self().size());
+        for (size_t i = 0 ; i != __div ; ++i)
+            if (~self().word(i) != 0) return false;
+        return __mod == 0 || (~self().word(__div) & mask_low(__mod)) == 0;
+    }
+
+    constexpr bool test(size_t __n) const {
+        const auto [__div, __mod] = div_mod(__n);
+        return (self().word(__div) >> __mod) & 1;
+    }
+};
+
+/* Leaf node: words of an existing bitset, which must outlive it. */
+struct expr_leaf : expr_base <expr_leaf> {
+    const _Word_t * ptr;    // Pointer to the first word
+    size_t          len;    // Number of bits
+
+    constexpr expr_leaf(const _Word_t *__ptr, size_t __len)
+    noexcept : ptr(__ptr), len(__len) {}
+
+    constexpr _Word_t word(size_t __n) const { return ptr[__n]; }
+    constexpr size_t  size() const { return len; }
+};
+
+/* Binary node, as long as the shorter operand. */
+template <typename _Op, bit_expr _Lhs, bit_expr _Rhs>
+struct expr_binary : expr_base <expr_binary <_Op, _Lhs, _Rhs>> {
+    _Lhs lhs;
+    _Rhs rhs;
+
+    constexpr expr_binary(const _Lhs &__lhs, const _Rhs &__rhs)
+    noexcept : lhs(__lhs), rhs(__rhs) {}
+
+    constexpr _Word_t word(size_t __n) const { return _Op {} (lhs.word(__n), rhs.word(__n)); }
+    constexpr size_t  size() const {
+        const auto __l = lhs.size(), __r = rhs.size();
+        return __l < __r ? __l : __r;
+    }
+};
+
+/* Flip node. Unused bits are dropped at evaluation. */
+template <bit_expr _Tp>
+struct expr_not : expr_base <expr_not <_Tp>> {
+    _Tp val;
+
+    constexpr explicit expr_not(const _Tp &__val) noexcept : val(__val) {}
+
+    constexpr _Word_t word(size_t __n) const { return ~val.word(__n); }
+    constexpr size_t  size() const { return val.size(); }
+};
+
+/* Write __n words of the expression into __dst and validate. */
+template <bit_expr _Expr>
+inline constexpr void eval(_Word_t *__dst, const _Expr &__e, size_t __n) {
+    for (size_t i = 0 ; i != __n ; ++i) __dst[i] = __e.word(i);
+    validate(__dst, __e.size());
+}
+
+static_assert(std::endian::native == std::endian::little,
+    "Our implement only supports little endian now.");
+
+/* 2-pointer small struct. */
+struct vec2 { _Word_t *dst; const _Word_t *src; };
+
+inline static constexpr vec2
+operator << (vec2 __vec, size_t __n) { return {__vec.dst, __vec.src - __n}; }
+inline static constexpr vec2
+operator >> (vec2 __vec, size_t __n) { return {__vec.dst, __vec.src + __n}; }
+inline static constexpr vec2
+operator + (vec2 __vec, size_t __n) { return {__vec.dst + __n, __vec.src + __n}; }
+
+/* Lshift word by word (with memmove) */
+inline constexpr void
+word_lshift(vec2 __vec, size_t __n, size_t __shift) {
+    if (__shift == 0) return;
+    const auto [__dst, __src] = __vec;
+    const auto __offset = __shift / __WBits;
+    const auto __count  = div_ceil(__n) - __offset;
+    word_copy<true>(__dst + __offset, __src, __count);
+    return word_reset(__dst, 0, __offset);
+}
+
+/* Rshift word by word. */
+inline constexpr void
+word_rshift(vec2 __vec, size_t __n, size_t __shift) {
+    if (__shift == 0) return;
+    const auto [__dst, __src] = __vec;
+    const auto __offset = __shift / __WBits;
+    const auto __count  = div_ceil(__n); // __n is the length after shift.
+    return word_copy<true>(__dst, __src + __offset, __count);
+}
+
+/* Lshift bits by bits. */
+inline constexpr void
+bits_lshift(vec2 __vec, size_t __n, size_t __shift) {
+    const auto [__div, __mod] = div_mod(__shift);
+
+    const auto __len = div_down(__n);
+    const auto __rev = rev_bits(__mod); // 64 - __mod
+    const auto __end = __vec.src;
+
+    auto [__dst, __src] = (__vec + __len) << __div;
+
+    /* The last word may be unsafe. */
+    auto __pre = div_down(__n - __mod) == __len ? *__src : 0;
+
+    while (__src != __end) {
+        auto __cur = *--__src;
+        *__dst-- = __pre << __mod | __cur >> __rev;
+        __pre = __cur; // Update the previous word.
+    }
+
+    /* The first word must be safe. */
+    *__dst = __pre << __mod;
+
+    /* Validate those words in the front. */
+    return word_reset(__dst - __div, 0, __div);
+}
+
+/* Lshift bits by bits. */
+inline constexpr void
+bits_rshift(vec2 __vec, size_t __n, size_t __shift) {
+    const auto [__div, __mod] = div_mod(__shift);
+
+    const auto __len = div_down(__n);
+    const auto __rev = rev_bits(__mod); // 64 - __mod
+    const auto __end = __vec.dst + __len;
+
+    auto [__dst, __src] = __vec >> __div;
+    /* The first word must be safe. */
+    auto __pre = *__src;
+
+    while (__dst != __end) {
+        auto __cur = *++__src;
+        *__dst++ = __pre >> __mod | __cur << __rev;
+        __pre = __cur; // Update the previous word.
+    }
+
+    /* The last word may be unsafe. */
+    auto __cur = div_down(__n + __mod) == __len ? 0 : *++__src;
+
+    /* Rely on the fact that the unused bit of src is filled with 0. */
+    *__dst = __pre >> __mod | __cur << __rev;
+}
+
+/* Perform left shift operation without any validation. */
+inline constexpr void
+do_lshift(vec2 __vec, size_t __n, size_t __shift) {
+    if (__shift % __WBits != 0)
+        return bits_lshift(__vec, __n, __shift);
+    else // __shift % CHAR_BIT == 0. Align to byte.
+        return word_lshift(__vec, __n, __shift);
+}
+
+/* Perform right shift operation with natural validation. */
+inline constexpr void
+do_rshift(vec2 __vec, size_t __n, size_t __shift) {
+    if (__shift % __WBits != 0)
+        return bits_rshift(__vec, __n, __shift);
+    else // __shift % CHAR_BIT == 0. Align to byte.
+        return word_rshift(__vec, __n, __shift);
+}
+
+/* Word __i of a bitset of __n words, shifted towards higher index. */
+inline constexpr _Word_t
+shl_word(const _Word_t *__src, size_t __n, size_t __i, size_t __div, size_t __mod) {
+    if (__i < __div) return 0;
+    const auto __j = __i - __div;
+    _Word_t __ret = __j < __n ? __src[__j] << __mod : 0;
+    if (__mod != 0 && __j != 0 && __j - 1 < __n)
+        __ret |= __src[__j - 1] >> rev_bits(__mod);
+    return __ret;
+}
+
+/* Word __i of a bitset of __n words, shifted towards lower index. */
+inline constexpr _Word_t
+shr_word(const _Word_t *__src, size_t __n, size_t __i, size_t __div, size_t __mod) {
+    const auto __j = __i + __div;
+    _Word_t __ret = __j < __n ? __src[__j] >> __mod : 0;
+    if (__mod != 0 && __j + 1 < __n)
+        __ret |= __src[__j + 1] << rev_bits(__mod);
+    return __ret;
+}
+
+/* Bulk fused shift on __n words, through the kernel table if long enough. */
+template <bool _And>
+inline constexpr void
+fused_shl(_Word_t *__dst, const _Word_t *__src, size_t __n, size_t __mod) {
+    if (std::is_constant_evaluated() || __n < __SimdMin)
+        return __scalar::shl <_And> (__dst, __src, __n, __mod);
+    return (_And ? kernel().and_shl : kernel().or_shl)(__dst, __src, __n, __mod);
+}
+
+template <bool _And>
+inline constexpr void
+fused_shr(_Word_t *__dst, const _Word_t *__src, size_t __n, size_t __mod) {
+    if (std::is_constant_evaluated() || __n < __SimdMin)
+        return __scalar::shr <_And> (__dst, __src, __n, __mod);
+    return (_And ? kernel().and_shr : kernel().or_shr)(__dst, __src, __n, __mod);
+}
+
+/**
+ * __dst[0, __n) op= __src[0, __m) shifted towards higher index by __k,
+ * where op is & if _And, else |. One pass from the top word down, so
+ * __src may be __dst: each word only reads source words at or below
+ * itself, which are not yet written.
+ */
+template <bool _And>
+inline constexpr void
+fused_lshift(_Word_t *__dst, size_t __n, const _Word_t *__src, size_t __m, size_t __k) {
+    const auto [__div, __mod] = div_mod(__k);
+    const auto __top = div_ceil(__m);
+    const auto __apply = [__dst](size_t i, _Word_t __val) {
+        __dst[i] = _And ? __dst[i] & __val : __dst[i] | __val;
+    };
+    auto i = div_ceil(__n);
+    if (__mod == 0) {
+        while (i-- != 0) __apply(i, shl_word(__src, __top, i, __div, 0));
+        return validate(__dst, __n);
+    }
+    /* Words in [__div + 1, __hi) read two source words in range. */
+    const auto __lo = __div + 1;
+    const auto __hi = std::max(__lo, std::min(i, __top + __div));
+    for (; i > __hi ; --i) __apply(i - 1, shl_word(__src, __top, i - 1, __div, __mod));
+    fused_shl <_And> (__dst + __lo, __src + 1, __hi - __lo, __mod);
+    for (i = std::min(i, __lo) ; i-- != 0 ;) __apply(i, shl_word(__src, __top, i, __div, __mod));
+    validate(__dst, __n);
+}
+
+/**
+ * __dst[0, __n) op= __src[0, __m) shifted towards lower index by __k.
+ * One pass from the bottom word up, so __src may be __dst.
+ */
+template <bool _And>
+inline constexpr void
+fused_rshift(_Word_t *__dst, size_t __n, const _Word_t *__src, size_t __m, size_t __k) {
+    const auto [__div, __mod] = div_mod(__k);
+    const auto __top = div_ceil(__m);
+    const auto __end = div_ceil(__n);
+    size_t i = 0;
+    if (__mod != 0) {
+        /* Words in [0, __safe) read two source words in range. */
+        const auto __safe = std::min(__end, __top > __div + 1 ? __top - __div - 1 : 0);
+        fused_shr <_And> (__dst, __src + __div, __safe, __mod);
+        i = __safe;
+    }
+    for (; i != __end ; ++i) {
+        const auto __val = shr_word(__src, __top, i, __div, __mod);
+        __dst[i] = _And ? __dst[i] & __val : __dst[i] | __val;
+    }
+    validate(__dst, __n);
+}
+
+
+} // namespace __detail::__bitset
+
+
+struct dynamic_bitset : private __detail::__bitset::dynamic_storage {
+  public:
+    using _Bitset   = dynamic_bitset;
+    using reference = __detail::__bitset::reference;
+
+    inline static constexpr size_t npos = -1;
+
+  private:
+    using _Base_t = __detail::__bitset::dynamic_storage;
+    using _Word_t = __detail::__bitset::_Word_t;
+
+    constexpr static _Word_t min(_Word_t __x, _Word_t __y) { return __x < __y ? __x : __y; }
+  public:
+    /* ctor and operator section. */
+
+    constexpr dynamic_bitset() = default;
+    constexpr ~dynamic_bitset() = default;
+
+    constexpr dynamic_bitset(const dynamic_bitset &) = default;
+    constexpr dynamic_bitset(dynamic_bitset &&) noexcept = default;
+
+    constexpr dynamic_bitset &operator = (const dynamic_bitset &) = default;
+    constexpr dynamic_bitset &operator = (dynamic_bitset &&) noexcept = default;
+
+    constexpr dynamic_bitset(size_t __n) : _Base_t(__n, nullptr) {}
+
+    constexpr dynamic_bitset(size_t __n, bool __x) : _Base_t(__n) {
+        __detail::__bitset::word_reset(this->data(), __x, this->word_count());
+        if (__x) __detail::__bitset::validate(this->data(), length);
+    }
+
+    /* Character i is bit i. Any character other than '1' is read as 0. */
+    constexpr dynamic_bitset(std::string_view __str) : dynamic_bitset(__str.size()) {
+        __detail::__bitset::parse_bin(this->data(), __str.data(), __str.size());
+    }
+
+    /* Parse binary text strictly. Throw std::invalid_argument on bad characters. */
+    static constexpr _Bitset from_string(std::string_view __str) {
+        _Bitset __ret(__str.size());
+        if (!__detail::__bitset::parse_bin(__ret.data(), __str.data(), __str.size()))
+            throw std::invalid_argument("dynamic_bitset::from_string");
+        return __ret;
+    }
+
+    /**
+     * Parse hex text of 4 * __str.size() bits, where digit i holds
+     * bits [4i, 4i + 4). Throw std::invalid_argument on bad digits.
+     */
+    static constexpr _Bitset from_hex(std::string_view __str) {
+        _Bitset __ret(__str.size() * 4);
+        if (!__detail::__bitset::parse_hex(__ret.data(), __str.data(), __str.size()))
+            throw std::invalid_argument("dynamic_bitset::from_hex");
+        return __ret;
+    }
+
+    constexpr _Bitset &operator |= (const _Bitset &__rhs) {
+        const auto __min = this->min(length, __rhs.length);
+        __detail::__bitset::do_or_(this->data(), __rhs.data(), __min);
+        return *this;
+    }
+
+    constexpr _Bitset &operator &= (const _Bitset &__rhs) {
+        const auto __min = this->min(length, __rhs.length);
+        __detail::__bitset::do_and(this->data(), __rhs.data(), __min);
+        return *this;
+    }
+
+    constexpr _Bitset &operator ^= (const _Bitset &__rhs) {
+        const auto __min = this->min(length, __rhs.length);
+        __detail::__bitset::do_xor(this->data(), __rhs.data(), __min);
+        return *this;
+    }
+
+    template <size_t _Nm, typename _Word>
+    constexpr _Bitset &operator |= (const static_bitset <_Nm, _Word> &__rhs) {
+        const auto __min = this->min(length, _Nm);
+        __detail::__bitset::do_or_(this->data(), __rhs.word_data(), __min);
+        return *this;
+    }
+
+    template <size_t _Nm, typename _Word>
+    constexpr _Bitset &operator &= (const static_bitset <_Nm, _Word> &__rhs) {
+        const auto __min = this->min(length, _Nm);
+        __detail::__bitset::do_and(this->data(), __rhs.word_data(), __min);
+        return *this;
+    }
+
+    template <size_t _Nm, typename _Word>
+    constexpr _Bitset &operator ^= (const static_bitset <_Nm, _Word> &__rhs) {
+        const auto __min = this->min(length, _Nm);
+        __detail::__bitset::do_xor(this->data(), __rhs.word_data(), __min);
+        return *this;
+    }
+
+    constexpr _Bitset &operator <<= (size_t __n) {
+        if (!length) return this->assign(__n, 0), *this;
+        length += __n;
+
+        /* Grow in place if possible, then shift within the buffer. */
+        this->grow_buffer(this->word_count());
+
+        const auto __data = this->data();
+        __detail::__bitset::do_lshift({__data, __data}, length, __n);
+        __detail::__bitset::validate(__data, length);
+        return *this;
+    }
+
+    constexpr _Bitset &operator >>= (size_t __n) {
+        if (__n < length) {
+            length -= __n;
+            const auto __data = this->data();
+            __detail::__bitset::do_rshift({__data, __data}, length, __n);
+        } else this->clear();
+        return *this;
+    }
+
+    /* Evaluate an expression in one pass. */
+    template <__detail::__bitset::bit_expr _Expr>
+    constexpr dynamic_bitset(const _Expr &__e) : _Base_t(__e.size()) {
+        __detail::__bitset::eval(this->data(), __e, this->word_count());
+    }
+
+    /* Evaluate an expression in one pass. It may refer to *this. */
+    template <__detail::__bitset::bit_expr _Expr>
+    constexpr _Bitset &operator = (const _Expr &__e) {
+        const auto __size = __detail::__bitset::div_ceil(__e.size());
+        if (this->word_capacity() < __size) {
+            _Bitset __temp(__e);
+            this->swap(__temp);
+        } else {
+            length = __e.size();
+            __detail::__bitset::eval(this->data(), __e, __size);
+        }
+        return *this;
+    }
+
+    template <__detail::__bitset::bit_expr _Expr>
+    constexpr _Bitset &operator |= (const _Expr &__e) {
+        using namespace __detail::__bitset;
+        const auto [__div, __mod] = div_mod(this->min(length, __e.size()));
+        for (size_t i = 0 ; i != __div ; ++i) this->data(i) |= __e.word(i);
+        if (__mod != 0) this->data(__div) |= __e.word(__div) & mask_low(__mod);
+        return *this;
+    }
+
+    template <__detail::__bitset::bit_expr _Expr>
+    constexpr _Bitset &operator &= (const _Expr &__e) {
+        using namespace __detail::__bitset;
+        const auto [__div, __mod] = div_mod(this->min(length, __e.size()));
+        for (size_t i = 0 ; i != __div ; ++i) this->data(i) &= __e.word(i);
+        if (__mod != 0) this->data(__div) &= __e.word(__div) | mask_top(__mod);
+        return *this;
+    }
+
+    template <__detail::__bitset::bit_expr _Expr>
+    constexpr _Bitset &operator ^= (const _Expr &__e) {
+        using namespace __detail::__bitset;
+        const auto [__div, __mod] = div_mod(this->min(length, __e.size()));
+        for (size_t i = 0 ; i != __div ; ++i) this->data(i) ^= __e.word(i);
+        if (__mod != 0) this->data(__div) ^= __e.word(__div) & mask_low(__mod);
+        return *this;
+    }
+
+    constexpr void swap(_Bitset &__rhs) noexcept { _Base_t::swap(__rhs); }
+
+    /**
+     * Section of fused shift operations, e.g. dp.or_shifted_left(w) for
+     * dp |= dp << w. One pass in the safe direction, no allocation, and
+     * the size is kept: bits shifted past the end are dropped. The source
+     * is zero-extended (or truncated) to size() bits.
+     */
+
+    /* *this |= __src << __k. __src may be *this. */
+    constexpr _Bitset &or_shifted_left(const _Bitset &__src, size_t __k) {
+        __detail::__bitset::fused_lshift <false> (this->data(), length, __src.data(), __src.length, __k);
+        return *this;
+    }
+    /* *this |= __src >> __k. __src may be *this. */
+    constexpr _Bitset &or_shifted_right(const _Bitset &__src, size_t __k) {
+        __detail::__bitset::fused_rshift <false> (this->data(), length, __src.data(), __src.length, __k);
+        return *this;
+    }
+    /* *this &= __src << __k. __src may be *this. */
+    constexpr _Bitset &and_shifted_left(const _Bitset &__src, size_t __k) {
+        __detail::__bitset::fused_lshift <true> (this->data(), length, __src.data(), __src.length, __k);
+        return *this;
+    }
+    /* *this &= __src >> __k. __src may be *this. */
+    constexpr _Bitset &and_shifted_right(const _Bitset &__src, size_t __k) {
+        __detail::__bitset::fused_rshift <true> (this->data(), length, __src.data(), __src.length, __k);
+        return *this;
+    }
+
+    /* *this |= *this << __k. */
+    constexpr _Bitset &or_shifted_left(size_t __k)   { return this->or_shifted_left(*this, __k);   }
+    /* *this |= *this >> __k. */
+    constexpr _Bitset &or_shifted_right(size_t __k)  { return this->or_shifted_right(*this, __k);  }
+    /* *this &= *this << __k. */
+    constexpr _Bitset &and_shifted_left(size_t __k)  { return this->and_shifted_left(*this, __k);  }
+    /* *this &= *this >> __k. */
+    constexpr _Bitset &and_shifted_right(size_t __k) { return this->and_shifted_right(*this, __k); }
+
+  public:
+    /**
+     * Section of reductions against another bitset. Nothing is built:
+     * (*this op __rhs) is counted or tested word by word. Sizes may
+     * differ, the shorter one reads as zero-extended.
+     */
+
+    /* Return |*this & __rhs|. */
+    constexpr size_t and_count(const _Bitset &__rhs) const {
+        const auto __w = this->min(this->word_count(), __rhs.word_count());
+        using enum __detail::__bitset::reduce_op;
+        return __detail::__bitset::count_of <and_> (this->data(), __rhs.data(), __w);
+    }
+    /* Return |*this | __rhs|. */
+    constexpr size_t or_count(const _Bitset &__rhs) const {
+        return this->count_with <__detail::__bitset::reduce_op::or_> (__rhs);
+    }
+    /* Return |*this ^ __rhs|, the Hamming distance. */
+    constexpr size_t xor_count(const _Bitset &__rhs) const {
+        return this->count_with <__detail::__bitset::reduce_op::xor_> (__rhs);
+    }
+
+    /* Return whether *this and __rhs have a common 1 bit. */
+    constexpr bool intersects(const _Bitset &__rhs) const {
+        const auto __w = this->min(this->word_count(), __rhs.word_count());
+        using enum __detail::__bitset::reduce_op;
+        return !__detail::__bitset::none_of <and_> (this->data(), __rhs.data(), __w);
+    }
+    /* Return whether every 1 bit of *this is also 1 in __rhs. */
+    constexpr bool is_subset_of(const _Bitset &__rhs) const {
+        const auto __w = this->min(this->word_count(), __rhs.word_count());
+        using enum __detail::__bitset::reduce_op;
+        return __detail::__bitset::none_of <andn> (this->data(), __rhs.data(), __w)
+            && __detail::__bitset::is_none(this->data() + __w, this->word_count() - __w);
+    }
+
+    /**
+     * One-vs-many forms: __out[i] = and_count (or_count, xor_count) of
+     * *this and candidate i, for __n candidates of size() bits stored
+     * back to back from __base, word_count() words each (e.g. the rows
+     * of a bit_matrix with size() columns).
+     */
+
+    void and_count_many(const _Word_t *__base, size_t __n, size_t *__out) const {
+        this->count_many <__detail::__bitset::reduce_op::and_> (__base, __n, __out);
+    }
+    void or_count_many(const _Word_t *__base, size_t __n, size_t *__out) const {
+        this->count_many <__detail::__bitset::reduce_op::or_> (__base, __n, __out);
+    }
+    void xor_count_many(const _Word_t *__base, size_t __n, size_t *__out) const {
+        this->count_many <__detail::__bitset::reduce_op::xor_> (__base, __n, __out);
+    }
+
+    friend constexpr bool operator == (const _Bitset &__lhs, const _Bitset &__rhs) {
+        using enum __detail::__bitset::reduce_op;
+        return __lhs.length == __rhs.length
+            && __detail::__bitset::none_of <xor_> (__lhs.data(), __rhs.data(), __lhs.word_count());
+    }
+
+    /* Hash of size and bits, consistent with operator ==. */
+    constexpr size_t hash() const {
+        return __detail::__bitset::hash_words(this->data(), this->word_count(), length);
+    }
+
+  private:
+    /* |*this op __rhs| for op in {|, ^}: words past the shorter one count as is. */
+    template <__detail::__bitset::reduce_op _Op>
+    constexpr size_t count_with(const _Bitset &__rhs) const {
+        const auto &__long = length < __rhs.length ? __rhs : *this;
+        const auto __w = this->min(this->word_count(), __rhs.word_count());
+        return __detail::__bitset::count_of <_Op> (this->data(), __rhs.data(), __w)
+            + __detail::__bitset::do_count(__long.data() + __w, __long.word_count() - __w);
+    }
+
+    template <__detail::__bitset::reduce_op _Op>
+    void count_many(const _Word_t *__base, size_t __n, size_t *__out) const {
+        const auto __w = this->word_count();
+        __detail::__bitset::count_many <_Op> (this->data(), __base, __w, __n, __out);
+    }
+
+  public:
+    /* Section of member functions that won't bring size changes. */
+
+    constexpr _Bitset &set() {
+        const auto __size = this->word_count();
+        __detail::__bitset::word_reset(this->data(), 1, __size);
+        __detail::__bitset::validate(this->data(), length);
+        return *this;
+    }
+
+    constexpr _Bitset &flip() {
+        __detail::__bitset::do_not(this->data(), this->word_count());
+        __detail::__bitset::validate(this->data(), length);
+        return *this;
+    }
+
+    constexpr _Bitset &reset() {
+        const auto __size = this->word_count();
+        __detail::__bitset::word_reset(this->data(), 0, __size);
+        return *this;
+    }
+
+    /* Return whether there is any bit set to 1. */
+    constexpr bool any() const { return !this->none(); }
+    /* Return whether all bits are set to 1. */
+    constexpr bool all() const {
+        return __detail::__bitset::is_all(this->data(), length);
+    }
+    /* Return whether all bits are set to 0. */
+    constexpr bool none() const {
+        return __detail::__bitset::is_none(this->data(), this->word_count());
+    }
+
+    /* Return the number of bits set to 1. */
+    constexpr size_t count() const {
+        return __detail::__bitset::do_count(this->data(), this->word_count());
+    }
+
+    constexpr void set(size_t __n)       { (*this)[__n].set();     }
+    constexpr void reset(size_t __n)     { (*this)[__n].reset();   }
+    constexpr void flip(size_t __n)      { (*this)[__n].flip();    }
+
+    constexpr bool test(size_t __n) const {
+        auto [__div, __mod] = __detail::__bitset::div_mod(__n);
+        return (data(__div) >> __mod) & 1;
+    }
+
+    /* Section of range operations on [__l, __r), where __l <= __r <= size(). */
+
+    constexpr _Bitset &set(size_t __l, size_t __r) {
+        __detail::__bitset::range_reset(this->data(), __l, __r, 1);
+        return *this;
+    }
+    constexpr _Bitset &reset(size_t __l, size_t __r) {
+        __detail::__bitset::range_reset(this->data(), __l, __r, 0);
+        return *this;
+    }
+    constexpr _Bitset &flip(size_t __l, size_t __r) {
+        __detail::__bitset::range_flip(this->data(), __l, __r);
+        return *this;
+    }
+
+    /* Return the number of 1 bits in [__l, __r). */
+    constexpr size_t count(size_t __l, size_t __r) const {
+        return __detail::__bitset::range_count(this->data(), __l, __r);
+    }
+    /* Return whether there is any 1 bit in [__l, __r). */
+    constexpr bool any(size_t __l, size_t __r) const { return !this->none(__l, __r); }
+    /* Return whether all bits in [__l, __r) are 0. */
+    constexpr bool none(size_t __l, size_t __r) const {
+        return __detail::__bitset::range_none(this->data(), __l, __r);
+    }
+
+    constexpr size_t size()  const { return length; }
+
+    /* Number of words in use. */
+    constexpr size_t word_count() const { return _Base_t::word_count(); }
+    /* Raw words. Unused bits of the last word must be kept 0. */
+    constexpr _Word_t *word_data() { return this->data(); }
+    /* Raw words. Unused bits of the last word are always 0. */
+    constexpr const _Word_t *word_data() const { return this->data(); }
+
+    constexpr reference operator [] (size_t __n) {
         auto [__div, __mod] = __detail::__bitset::div_mod(__n);
         return reference(data() + __div, __mod);
     }
@@ -555,8 +2211,84 @@ struct dynamic_bitset : private __detail::__bitset::dynamic_storage {
     constexpr bool front() const { return test(0); }
     constexpr bool back()  const { return test(length - 1); }
 
-    constexpr size_t find_first();
-    constexpr size_t find_next(size_t);
+    /* Return the index of the first 1 bit, or npos if none. */
+    constexpr size_t find_first() const {
+        return __detail::__bitset::find_next(this->data(), length, 0);
+    }
+    /* Return the index of the first 1 bit after __n, or npos if none. */
+    constexpr size_t find_next(size_t __n) const {
+        if (__n == npos) return npos;
+        return __detail::__bitset::find_next(this->data(), length, __n + 1);
+    }
+    /* Return the index of the first 1 bit in [__l, __r), or npos if none. */
+    constexpr size_t find_first(size_t __l, size_t __r) const {
+        return __detail::__bitset::range_find(this->data(), __l, __r);
+    }
+    /* Return the index of the first 1 bit in (__n, __r), or npos if none. */
+    constexpr size_t find_next(size_t __n, size_t __r) const {
+        if (__n == npos) return npos;
+        return __detail::__bitset::range_find(this->data(), __n + 1, __r);
+    }
+    /* Return the index of the last 1 bit, or npos if none. */
+    constexpr size_t find_last() const {
+        return __detail::__bitset::find_prev(this->data(), length, npos);
+    }
+    /* Return the index of the last 1 bit before __n, or npos if none. */
+    constexpr size_t find_prev(size_t __n) const {
+        if (__n == 0) return npos;
+        return __detail::__bitset::find_prev(this->data(), length, __n - 1);
+    }
+
+    /* Range of indices of 1 bits, for use in range-for. */
+    constexpr auto ones() const {
+        return __detail::__bitset::one_range {this->data(), this->word_count()};
+    }
+
+    /**
+     * Write indices of all 1 bits into __out, in increasing order.
+     * __out must hold at least count() elements.
+     * Return the number of indices written.
+     */
+    constexpr size_t extract_indices(uint32_t *__out) const {
+        return __detail::__bitset::extract_indices(__out, this->data(), this->word_count());
+    }
+
+    /* Binary text, where character i is bit i. */
+    constexpr std::string to_string() const {
+        std::string __ret(length, '0');
+        __detail::__bitset::format_bin(__ret.data(), this->data(), 0, length);
+        return __ret;
+    }
+
+    /* Hex text, where digit i holds bits [4i, 4i + 4). */
+    constexpr std::string to_hex() const {
+        std::string __ret((length + 3) / 4, '0');
+        __detail::__bitset::format_hex(__ret.data(), this->data(), length, 0, __ret.size());
+        return __ret;
+    }
+
+    /**
+     * Write bits [__pos, __pos + __n) as binary text into __out,
+     * which must hold __n characters. Return __n.
+     * Use this to stream a large bitset through a fixed buffer.
+     */
+    constexpr size_t write_string(char *__out, size_t __pos, size_t __n) const {
+        if (__pos > length || __n > length - __pos)
+            throw std::out_of_range("dynamic_bitset::write_string");
+        __detail::__bitset::format_bin(__out, this->data(), __pos, __n);
+        return __n;
+    }
+
+    /**
+     * Write __n hex digits for bits [__pos, __pos + 4 * __n) into __out.
+     * Bits past size() in the last digit are written as 0. Return __n.
+     */
+    constexpr size_t write_hex(char *__out, size_t __pos, size_t __n) const {
+        if (__pos > length || __n > (length - __pos + 3) / 4)
+            throw std::out_of_range("dynamic_bitset::write_hex");
+        __detail::__bitset::format_hex(__out, this->data(), length, __pos, __n);
+        return __n;
+    }
 
   public:
     /* Section of member functions that may bring size changes. */
@@ -573,11 +2305,69 @@ struct dynamic_bitset : private __detail::__bitset::dynamic_storage {
     constexpr void pop_back() noexcept { return _Base_t::pop_back(); }
     constexpr void clear()    noexcept { return _Base_t::clear();    }
 
+    /* Number of bits that fit without reallocation. */
+    constexpr size_t capacity() const {
+        return this->word_capacity() * __detail::__bitset::__WBits;
+    }
+
+    /* Make room for __n bits. */
+    constexpr void reserve(size_t __n) {
+        const auto __words = __detail::__bitset::div_ceil(__n);
+        if (this->word_capacity() < __words) this->resize_buffer(__words);
+    }
+
+    /* Release unused capacity. */
+    constexpr void shrink_to_fit() {
+        if (this->word_capacity() > this->word_count())
+            this->resize_buffer(this->word_count());
+    }
+
+    /* Change the size to __n. New bits are set to __x. */
+    constexpr void resize(size_t __n, bool __x = false) {
+        using namespace __detail::__bitset;
+        if (__n <= length) {
+            length = __n;
+            return validate(this->data(), length);
+        }
+        const auto __old = this->word_count();
+        this->grow_buffer(div_ceil(__n));
+        word_reset(this->data() + __old, 0, div_ceil(__n) - __old);
+        if (__x) range_reset(this->data(), length, __n, 1);
+        length = __n;
+    }
+
+    /* Append the low __n (<= 64) bits of __word. Higher bits are ignored. */
+    constexpr void append(_Word_t __word, size_t __n) {
+        using namespace __detail::__bitset;
+        if (__n == 0) return;
+        const auto [__div, __mod] = div_mod(length);
+        this->grow_buffer(div_ceil(length + __n));
+        __word &= mask_end(__n);
+        if (__mod == 0) {
+            this->data(__div) = __word;
+        } else {
+            this->data(__div) |= __word << __mod;
+            if (__mod + __n > __WBits) this->data(__div + 1) = __word >> rev_bits(__mod);
+        }
+        length += __n;
+    }
+
+    /* Append all bits of __rhs, which may be *this. */
+    constexpr void append(const _Bitset &__rhs) {
+        using namespace __detail::__bitset;
+        const auto __n   = __rhs.length;
+        const auto __old = this->word_count();
+        this->grow_buffer(div_ceil(length + __n));
+        word_reset(this->data() + __old, 0, div_ceil(length + __n) - __old);
+        copy_range(this->data(), length, __rhs.data(), 0, __n);
+        length += __n;
+    }
+
     constexpr void assign(size_t __n, bool __x) {
         length = __n;
 
         const auto __size = this->word_count();
-        const auto __capa = this->capacity();
+        const auto __capa = this->word_capacity();
 
         if (__capa < __size) {
             this->dealloc();
@@ -617,4 +2407,466 @@ struct dynamic_bitset : private __detail::__bitset::dynamic_storage {
 };
 
 
+namespace __detail::__bitset {
+
+template <typename _Tp>
+struct is_static_bitset : std::false_type {};
+template <size_t _Nm, typename _Word>
+struct is_static_bitset <static_bitset <_Nm, _Word>> : std::true_type {};
+
+/* Bitsets and expressions which may appear in a bitset expression. */
+template <typename _Tp>
+concept bit_operand = bit_expr <_Tp>
+    || std::same_as <_Tp, dynamic_bitset>
+    || is_static_bitset <_Tp>::value;
+
+template <bit_operand _Tp>
+inline constexpr auto make_expr(const _Tp &__val) {
+    if constexpr (bit_expr <_Tp>)
+        return __val;
+    else
+        return expr_leaf {__val.word_data(), __val.size()};
+}
+
+template <typename _Tp>
+using expr_t = decltype(make_expr(std::declval <const _Tp &> ()));
+
+/**
+ * Operators below build expressions lazily. They are found by ADL,
+ * since dynamic_bitset derives from a class of this namespace.
+ * Operands are held by reference, so do not keep an expression
+ * alive beyond the bitsets it refers to.
+ */
+
+template <bit_operand _Lhs, bit_operand _Rhs>
+inline constexpr auto operator & (const _Lhs &__lhs, const _Rhs &__rhs) {
+    using _Expr = expr_binary <std::bit_and <>, expr_t <_Lhs>, expr_t <_Rhs>>;
+    return _Expr {make_expr(__lhs), make_expr(__rhs)};
+}
+
+template <bit_operand _Lhs, bit_operand _Rhs>
+inline constexpr auto operator | (const _Lhs &__lhs, const _Rhs &__rhs) {
+    using _Expr = expr_binary <std::bit_or <>, expr_t <_Lhs>, expr_t <_Rhs>>;
+    return _Expr {make_expr(__lhs), make_expr(__rhs)};
+}
+
+template <bit_operand _Lhs, bit_operand _Rhs>
+inline constexpr auto operator ^ (const _Lhs &__lhs, const _Rhs &__rhs) {
+    using _Expr = expr_binary <std::bit_xor <>, expr_t <_Lhs>, expr_t <_Rhs>>;
+    return _Expr {make_expr(__lhs), make_expr(__rhs)};
+}
+
+template <bit_operand _Tp>
+inline constexpr auto operator ~ (const _Tp &__val) {
+    return expr_not <expr_t <_Tp>> {make_expr(__val)};
+}
+
+} // namespace __detail::__bitset
+
+/**
+ * Fixed-size bitset of _Nm bits, stored inline.
+ * Shares word kernels with dynamic_bitset. Loops have a
+ * compile-time bound, so they fully unroll for small _Nm.
+ */
+template <size_t _Nm, typename _Word>
+struct static_bitset {
+    static_assert(std::is_same_v <_Word, __detail::__bitset::_Word_t>,
+        "Only size_t words are supported by bitset kernels now.");
+
+  public:
+    using _Bitset   = static_bitset;
+    using reference = __detail::__bitset::reference;
+
+    inline static constexpr size_t npos = -1;
+
+  private:
+    using _Word_t = _Word;
+
+    /* Number of words in use. */
+    inline static constexpr size_t __Words = __detail::__bitset::div_ceil(_Nm);
+
+    _Word_t words[__Words ? __Words : 1] {};
+
+    constexpr static size_t min(size_t __x, size_t __y) { return __x < __y ? __x : __y; }
+
+  public:
+    /* ctor and operator section. */
+
+    constexpr static_bitset() = default;
+
+    constexpr static_bitset(const char *__str)
+        : static_bitset(std::string_view {__str}) {}
+
+    /* Character i is bit i. Any character other than '1' is read as 0. */
+    constexpr static_bitset(std::string_view __str) {
+        const auto __len = this->min(_Nm, __str.size());
+        __detail::__bitset::parse_bin(words, __str.data(), __len);
+    }
+
+    constexpr _Bitset &operator |= (const _Bitset &__rhs) {
+        __detail::__bitset::do_or_(words, __rhs.words, _Nm);
+        return *this;
+    }
+
+    constexpr _Bitset &operator &= (const _Bitset &__rhs) {
+        __detail::__bitset::do_and(words, __rhs.words, _Nm);
+        return *this;
+    }
+
+    constexpr _Bitset &operator ^= (const _Bitset &__rhs) {
+        __detail::__bitset::do_xor(words, __rhs.words, _Nm);
+        return *this;
+    }
+
+    /* Same as dynamic_bitset: only the common prefix is touched. */
+    constexpr _Bitset &operator |= (const dynamic_bitset &__rhs) {
+        const auto __min = this->min(_Nm, __rhs.size());
+        __detail::__bitset::do_or_(words, __rhs.word_data(), __min);
+        return *this;
+    }
+
+    /* Same as dynamic_bitset: only the common prefix is touched. */
+    constexpr _Bitset &operator &= (const dynamic_bitset &__rhs) {
+        const auto __min = this->min(_Nm, __rhs.size());
+        __detail::__bitset::do_and(words, __rhs.word_data(), __min);
+        return *this;
+    }
+
+    /* Same as dynamic_bitset: only the common prefix is touched. */
+    constexpr _Bitset &operator ^= (const dynamic_bitset &__rhs) {
+        const auto __min = this->min(_Nm, __rhs.size());
+        __detail::__bitset::do_xor(words, __rhs.word_data(), __min);
+        return *this;
+    }
+
+    /* Shift towards higher index, bits beyond _Nm are dropped. */
+    constexpr _Bitset &operator <<= (size_t __n) {
+        if (__n >= _Nm) return this->reset();
+        if (__n == 0)   return *this;
+        __detail::__bitset::do_lshift({words, words}, _Nm, __n);
+        __detail::__bitset::validate(words, _Nm);
+        return *this;
+    }
+
+    /* Shift towards lower index, filling 0 in the top. */
+    constexpr _Bitset &operator >>= (size_t __n) {
+        if (__n >= _Nm) return this->reset();
+        if (__n == 0)   return *this;
+        const auto __len = _Nm - __n;
+        const auto __top = __detail::__bitset::div_ceil(__len);
+        __detail::__bitset::do_rshift({words, words}, __len, __n);
+        __detail::__bitset::word_reset(words + __top, 0, __Words - __top);
+        return *this;
+    }
+
+    constexpr _Bitset operator ~() const { return _Bitset(*this).flip(); }
+    constexpr _Bitset operator << (size_t __n) const { return _Bitset(*this) <<= __n; }
+    constexpr _Bitset operator >> (size_t __n) const { return _Bitset(*this) >>= __n; }
+
+    friend constexpr _Bitset operator & (_Bitset __lhs, const _Bitset &__rhs) { return __lhs &= __rhs; }
+    friend constexpr _Bitset operator | (_Bitset __lhs, const _Bitset &__rhs) { return __lhs |= __rhs; }
+    friend constexpr _Bitset operator ^ (_Bitset __lhs, const _Bitset &__rhs) { return __lhs ^= __rhs; }
+
+    /**
+     * Section of fused shift operations, e.g. dp.or_shifted_left(w) for
+     * dp |= dp << w. One pass in the safe direction, no allocation, and
+     * the size is kept: bits shifted past the end are dropped. The source
+     * is zero-extended (or truncated) to size() bits.
+     */
+
+    /* *this |= __src << __k. __src may be *this. */
+    constexpr _Bitset &or_shifted_left(const _Bitset &__src, size_t __k) {
+        __detail::__bitset::fused_lshift <false> (words, _Nm, __src.words, _Nm, __k);
+        return *this;
+    }
+    /* *this |= __src >> __k. __src may be *this. */
+    constexpr _Bitset &or_shifted_right(const _Bitset &__src, size_t __k) {
+        __detail::__bitset::fused_rshift <false> (words, _Nm, __src.words, _Nm, __k);
+        return *this;
+    }
+    /* *this &= __src << __k. __src may be *this. */
+    constexpr _Bitset &and_shifted_left(const _Bitset &__src, size_t __k) {
+        __detail::__bitset::fused_lshift <true> (words, _Nm, __src.words, _Nm, __k);
+        return *this;
+    }
+    /* *this &= __src >> __k. __src may be *this. */
+    constexpr _Bitset &and_shifted_right(const _Bitset &__src, size_t __k) {
+        __detail::__bitset::fused_rshift <true> (words, _Nm, __src.words, _Nm, __k);
+        return *this;
+    }
+
+    /* *this |= *this << __k. */
+    constexpr _Bitset &or_shifted_left(size_t __k)   { return this->or_shifted_left(*this, __k);   }
+    /* *this |= *this >> __k. */
+    constexpr _Bitset &or_shifted_right(size_t __k)  { return this->or_shifted_right(*this, __k);  }
+    /* *this &= *this << __k. */
+    constexpr _Bitset &and_shifted_left(size_t __k)  { return this->and_shifted_left(*this, __k);  }
+    /* *this &= *this >> __k. */
+    constexpr _Bitset &and_shifted_right(size_t __k) { return this->and_shifted_right(*this, __k); }
+
+    /* Section of reductions against another bitset. Nothing is built. */
+
+    /* Return |*this & __rhs|. */
+    constexpr size_t and_count(const _Bitset &__rhs) const {
+        using enum __detail::__bitset::reduce_op;
+        return __detail::__bitset::count_of <and_> (words, __rhs.words, __Words);
+    }
+    /* Return |*this | __rhs|. */
+    constexpr size_t or_count(const _Bitset &__rhs) const {
+        using enum __detail::__bitset::reduce_op;
+        return __detail::__bitset::count_of <or_> (words, __rhs.words, __Words);
+    }
+    /* Return |*this ^ __rhs|, the Hamming distance. */
+    constexpr size_t xor_count(const _Bitset &__rhs) const {
+        using enum __detail::__bitset::reduce_op;
+        return __detail::__bitset::count_of <xor_> (words, __rhs.words, __Words);
+    }
+
+    /* Return whether *this and __rhs have a common 1 bit. */
+    constexpr bool intersects(const _Bitset &__rhs) const {
+        using enum __detail::__bitset::reduce_op;
+        return !__detail::__bitset::none_of <and_> (words, __rhs.words, __Words);
+    }
+    /* Return whether every 1 bit of *this is also 1 in __rhs. */
+    constexpr bool is_subset_of(const _Bitset &__rhs) const {
+        using enum __detail::__bitset::reduce_op;
+        return __detail::__bitset::none_of <andn> (words, __rhs.words, __Words);
+    }
+
+    /* One-vs-many forms: __out[i] = and_count (...) of *this and __cand[i]. */
+
+    void and_count_many(const _Bitset *__cand, size_t __n, size_t *__out) const {
+        this->count_many <__detail::__bitset::reduce_op::and_> (__cand, __n, __out);
+    }
+    void or_count_many(const _Bitset *__cand, size_t __n, size_t *__out) const {
+        this->count_many <__detail::__bitset::reduce_op::or_> (__cand, __n, __out);
+    }
+    void xor_count_many(const _Bitset *__cand, size_t __n, size_t *__out) const {
+        this->count_many <__detail::__bitset::reduce_op::xor_> (__cand, __n, __out);
+    }
+
+    friend constexpr bool operator == (const _Bitset &__lhs, const _Bitset &__rhs) {
+        using enum __detail::__bitset::reduce_op;
+        return __detail::__bitset::none_of <xor_> (__lhs.words, __rhs.words, __Words);
+    }
+
+    /* Hash of size and bits, consistent with operator ==. */
+    constexpr size_t hash() const {
+        return __detail::__bitset::hash_words(words, __Words, _Nm);
+    }
+
+  private:
+    template <__detail::__bitset::reduce_op _Op>
+    void count_many(const _Bitset *__cand, size_t __n, size_t *__out) const {
+        static_assert(sizeof(_Bitset) == sizeof(words), "Bitsets must be packed now.");
+        if (__n == 0) return;
+        constexpr auto __w = sizeof(_Bitset) / sizeof(_Word_t);
+        __detail::__bitset::count_many <_Op> (words, __cand->words, __w, __n, __out);
+    }
+
+  public:
+    /* Section of member functions. */
+
+    constexpr _Bitset &set() {
+        __detail::__bitset::word_reset(words, 1, __Words);
+        __detail::__bitset::validate(words, _Nm);
+        return *this;
+    }
+
+    constexpr _Bitset &flip() {
+        __detail::__bitset::do_not(words, __Words);
+        __detail::__bitset::validate(words, _Nm);
+        return *this;
+    }
+
+    constexpr _Bitset &reset() {
+        __detail::__bitset::word_reset(words, 0, __Words);
+        return *this;
+    }
+
+    /* Return whether there is any bit set to 1. */
+    constexpr bool any() const { return !this->none(); }
+    /* Return whether all bits are set to 1. */
+    constexpr bool all() const { return __detail::__bitset::is_all(words, _Nm); }
+    /* Return whether all bits are set to 0. */
+    constexpr bool none() const { return __detail::__bitset::is_none(words, __Words); }
+
+    /* Return the number of bits set to 1. */
+    constexpr size_t count() const { return __detail::__bitset::do_count(words, __Words); }
+
+    constexpr void set(size_t __n)       { (*this)[__n].set();     }
+    constexpr void reset(size_t __n)     { (*this)[__n].reset();   }
+    constexpr void flip(size_t __n)      { (*this)[__n].flip();    }
+
+    constexpr bool test(size_t __n) const {
+        auto [__div, __mod] = __detail::__bitset::div_mod(__n);
+        return (words[__div] >> __mod) & 1;
+    }
+
+    /* Section of range operations on [__l, __r), where __l <= __r <= size(). */
+
+    constexpr _Bitset &set(size_t __l, size_t __r) {
+        __detail::__bitset::range_reset(words, __l, __r, 1);
+        return *this;
+    }
+    constexpr _Bitset &reset(size_t __l, size_t __r) {
+        __detail::__bitset::range_reset(words, __l, __r, 0);
+        return *this;
+    }
+    constexpr _Bitset &flip(size_t __l, size_t __r) {
+        __detail::__bitset::range_flip(words, __l, __r);
+        return *this;
+    }
+
+    /* Return the number of 1 bits in [__l, __r). */
+    constexpr size_t count(size_t __l, size_t __r) const {
+        return __detail::__bitset::range_count(words, __l, __r);
+    }
+    /* Return whether there is any 1 bit in [__l, __r). */
+    constexpr bool any(size_t __l, size_t __r) const { return !this->none(__l, __r); }
+    /* Return whether all bits in [__l, __r) are 0. */
+    constexpr bool none(size_t __l, size_t __r) const {
+        return __detail::__bitset::range_none(words, __l, __r);
+    }
+
+    constexpr static size_t size() { return _Nm; }
+
+    /* Number of words in use. */
+    constexpr static size_t word_count() { return __Words; }
+    /* Raw words. Unused bits of the last word must be kept 0. */
+    constexpr _Word_t *word_data() { return words; }
+    /* Raw words. Unused bits of the last word are always 0. */
+    constexpr const _Word_t *word_data() const { return words; }
+
+    constexpr reference operator [] (size_t __n) {
+        auto [__div, __mod] = __detail::__bitset::div_mod(__n);
+        return reference(words + __div, __mod);
+    }
+    constexpr reference at(size_t __n) { this->range_check(__n); return (*this)[__n]; }
+    constexpr bool operator [] (size_t __n) const { return test(__n); }
+    constexpr bool at(size_t __n) const { range_check(__n); return test(__n); }
+
+    constexpr reference front() { return (*this)[0]; }
+    constexpr reference back()  { return (*this)[_Nm - 1]; }
+    constexpr bool front() const { return test(0); }
+    constexpr bool back()  const { return test(_Nm - 1); }
+
+    /* Return the index of the first 1 bit, or npos if none. */
+    constexpr size_t find_first() const {
+        return __detail::__bitset::find_next(words, _Nm, 0);
+    }
+    /* Return the index of the first 1 bit after __n, or npos if none. */
+    constexpr size_t find_next(size_t __n) const {
+        if (__n == npos) return npos;
+        return __detail::__bitset::find_next(words, _Nm, __n + 1);
+    }
+    /* Return the index of the first 1 bit in [__l, __r), or npos if none. */
+    constexpr size_t find_first(size_t __l, size_t __r) const {
+        return __detail::__bitset::range_find(words, __l, __r);
+    }
+    /* Return the index of the first 1 bit in (__n, __r), or npos if none. */
+    constexpr size_t find_next(size_t __n, size_t __r) const {
+        if (__n == npos) return npos;
+        return __detail::__bitset::range_find(words, __n + 1, __r);
+    }
+    /* Return the index of the last 1 bit, or npos if none. */
+    constexpr size_t find_last() const {
+        return __detail::__bitset::find_prev(words, _Nm, npos);
+    }
+    /* Return the index of the last 1 bit before __n, or npos if none. */
+    constexpr size_t find_prev(size_t __n) const {
+        if (__n == 0) return npos;
+        return __detail::__bitset::find_prev(words, _Nm, __n - 1);
+    }
+
+    /* Range of indices of 1 bits, for use in range-for. */
+    constexpr auto ones() const {
+        return __detail::__bitset::one_range {words, __Words};
+    }
+
+    /**
+     * Write indices of all 1 bits into __out, in increasing order.
+     * __out must hold at least count() elements.
+     * Return the number of indices written.
+     */
+    constexpr size_t extract_indices(uint32_t *__out) const {
+        return __detail::__bitset::extract_indices(__out, words, __Words);
+    }
+
+    /* Binary text, where character i is bit i. */
+    constexpr std::string to_string() const {
+        std::string __ret(_Nm, '0');
+        __detail::__bitset::format_bin(__ret.data(), words, 0, _Nm);
+        return __ret;
+    }
+
+    /* Hex text, where digit i holds bits [4i, 4i + 4). */
+    constexpr std::string to_hex() const {
+        std::string __ret((_Nm + 3) / 4, '0');
+        __detail::__bitset::format_hex(__ret.data(), words, _Nm, 0, __ret.size());
+        return __ret;
+    }
+
+    /**
+     * Write bits [__pos, __pos + __n) as binary text into __out,
+     * which must hold __n characters. Return __n.
+     * Use this to stream a large bitset through a fixed buffer.
+     */
+    constexpr size_t write_string(char *__out, size_t __pos, size_t __n) const {
+        if (__pos > _Nm || __n > _Nm - __pos)
+            throw std::out_of_range("static_bitset::write_string");
+        __detail::__bitset::format_bin(__out, words, __pos, __n);
+        return __n;
+    }
+
+    /**
+     * Write __n hex digits for bits [__pos, __pos + 4 * __n) into __out.
+     * Bits past size() in the last digit are written as 0. Return __n.
+     */
+    constexpr size_t write_hex(char *__out, size_t __pos, size_t __n) const {
+        if (__pos > _Nm || __n > (_Nm - __pos + 3) / 4)
+            throw std::out_of_range("static_bitset::write_hex");
+        __detail::__bitset::format_hex(__out, words, _Nm, __pos, __n);
+        return __n;
+    }
+
+    constexpr void range_check(size_t __n) const {
+        if (__n >= _Nm)
+            throw std::out_of_range("static_bitset::range_check");
+    }
+};
+
+
+/**
+ * Copy __n bits from __src at __spos to __dst at __dpos.
+ * Offsets may be unaligned, and __dst may be __src (like memmove).
+ * Throw std::out_of_range if either range exceeds its bitset.
+ */
+template <typename _Dst, typename _Src>
+requires requires (_Dst &__dst, const _Src &__src) {
+    { __dst.word_data() } -> std::same_as <__detail::__bitset::_Word_t *>;
+    { __src.word_data() } -> std::convertible_to <const __detail::__bitset::_Word_t *>;
+    { __dst.size() } -> std::convertible_to <size_t>;
+    { __src.size() } -> std::convertible_to <size_t>;
+}
+inline constexpr void copy_range(_Dst &__dst, size_t __dpos,
+                                 const _Src &__src, size_t __spos, size_t __n) {
+    if (__dpos > __dst.size() || __n > __dst.size() - __dpos
+    ||  __spos > __src.size() || __n > __src.size() - __spos)
+        throw std::out_of_range("copy_range");
+    __detail::__bitset::copy_range(__dst.word_data(), __dpos, __src.word_data(), __spos, __n);
+}
+
+
 } // namespace dark
+
+
+template <>
+struct std::hash <dark::dynamic_bitset> {
+    size_t operator()(const dark::dynamic_bitset &__val) const noexcept { return __val.hash(); }
+};
+
+template <size_t _Nm, typename _Word>
+struct std::hash <dark::static_bitset <_Nm, _Word>> {
+    size_t operator()(const dark::static_bitset <_Nm, _Word> &__val) const noexcept { return __val.hash(); }
+};
@@ -0,0 +1,170 @@
+#pragma once
+#include "bitset.h"
+#include "../utility/thread_pool.h"
+#include <cstdint>
+#include <vector>
+
+namespace dark {
+
+
+namespace __detail::__bitset {
+
+/* Words per cache line. */
+inline constexpr size_t __LineWords = 64 / sizeof(_Word_t);
+
+/* Below this number of words, bulk operations stay serial. */
+inline constexpr size_t __ParMin = size_t{1} << 15;
+
+/**
+ * Split __n words starting at __base into about __k chunks.
+ * Inner boundaries fall on cache lines, so no line is written by
+ * two threads. Call __fn(index, begin, end) for each chunk on the
+ * pool. There are at most __k chunks.
+ */
+template <typename _Fn>
+inline void for_chunks(thread_pool &__pool, const _Word_t *__base,
+                       size_t __n, size_t __k, _Fn &&__fn) {
+    const auto __addr = reinterpret_cast <std::uintptr_t> (__base);
+    const auto __head = (-__addr % 64) / sizeof(_Word_t); // Words before first line.
+    auto __size = (__n + __k - 1) / __k;
+    __size = (__size + __LineWords - 1) / __LineWords * __LineWords;
+
+    const auto __bound = [=](size_t __i) -> size_t {
+        return __i == 0 ? 0 : std::min(__n, __head + __i * __size);
+    };
+    const auto __cnt = __n <= __head ? 1 : (__n - __head + __size - 1) / __size;
+    __pool.parallel_for(__cnt, [&](size_t __i) { __fn(__i, __bound(__i), __bound(__i + 1)); });
+}
+
+} // namespace __detail::__bitset
+
+
+/**
+ * Runs dynamic_bitset bulk operations on a thread pool.
+ * Word arrays are split into cache-line aligned chunks, and
+ * arrays shorter than the threshold (in words) stay serial.
+ * Results are the same as the serial operators.
+ */
+struct bitset_executor {
+  private:
+    using _Word_t = __detail::__bitset::_Word_t;
+
+    thread_pool &   pool;       // Pool to run on
+    size_t          threshold;  // Min words to go parallel
+    size_t          split;      // Chunks per job
+
+    bool is_serial(size_t __words) const {
+        return __words < threshold || pool.size() == 1;
+    }
+
+    template <typename _Fn>
+    void for_chunks(const _Word_t *__base, size_t __n, _Fn &&__fn) const {
+        __detail::__bitset::for_chunks(pool, __base, __n, split, __fn);
+    }
+
+    /* Apply a logic kernel over the common prefix. */
+    template <typename _Fn>
+    void logic(dynamic_bitset &__lhs, const dynamic_bitset &__rhs, _Fn __fn) const {
+        const auto __min = std::min(__lhs.size(), __rhs.size());
+        const auto [__div, __mod] = __detail::__bitset::div_mod(__min);
+        const auto __dst = __lhs.word_data();
+        const auto __src = __rhs.word_data();
+        this->for_chunks(__dst, __div, [=](size_t, size_t __beg, size_t __end) {
+            __fn(__dst + __beg, __src + __beg, (__end - __beg) * __detail::__bitset::__WBits);
+        });
+        __fn(__dst + __div, __src + __div, __mod); // Tail only.
+    }
+
+  public:
+    explicit bitset_executor(thread_pool &__pool,
+        size_t __threshold = __detail::__bitset::__ParMin)
+        : pool(__pool), threshold(__threshold), split(__pool.size() * 4) {}
+
+    void assign_or(dynamic_bitset &__lhs, const dynamic_bitset &__rhs) const {
+        if (this->is_serial(__lhs.word_count())) { __lhs |= __rhs; return; }
+        this->logic(__lhs, __rhs, __detail::__bitset::do_or_);
+    }
+
+    void assign_and(dynamic_bitset &__lhs, const dynamic_bitset &__rhs) const {
+        if (this->is_serial(__lhs.word_count())) { __lhs &= __rhs; return; }
+        this->logic(__lhs, __rhs, __detail::__bitset::do_and);
+    }
+
+    void assign_xor(dynamic_bitset &__lhs, const dynamic_bitset &__rhs) const {
+        if (this->is_serial(__lhs.word_count())) { __lhs ^= __rhs; return; }
+        this->logic(__lhs, __rhs, __detail::__bitset::do_xor);
+    }
+
+    /* Return the number of bits set to 1. */
+    size_t count(const dynamic_bitset &__bits) const {
+        const auto __n = __bits.word_count();
+        if (this->is_serial(__n)) return __bits.count();
+        const auto __src = __bits.word_data();
+        std::vector <size_t> __part(split);
+        this->for_chunks(__src, __n, [&](size_t __i, size_t __beg, size_t __end) {
+            __part[__i] = __detail::__bitset::do_count(__src + __beg, __end - __beg);
+        });
+        size_t __cnt = 0;
+        for (const auto __c : __part) __cnt += __c;
+        return __cnt;
+    }
+
+    /* Same as __bits.assign(__n, __x). */
+    void assign(dynamic_bitset &__bits, size_t __n, bool __x) const {
+        const auto __words = __detail::__bitset::div_ceil(__n);
+        if (this->is_serial(__words)) return __bits.assign(__n, __x);
+        dynamic_bitset __temp(__n); // Zeroed by calloc, lazily.
+        if (__x) {
+            const auto __dst = __temp.word_data();
+            this->for_chunks(__dst, __words, [=](size_t, size_t __beg, size_t __end) {
+                __detail::__bitset::word_reset(__dst + __beg, 1, __end - __beg);
+            });
+            __detail::__bitset::validate(__dst, __n);
+        }
+        __bits.swap(__temp);
+    }
+
+    /**
+     * Same as __bits <<= __n, which grows the length by __n.
+     * Out of place: each chunk reads its source words and the
+     * carry word below, so chunk boundaries need no ordering.
+     */
+    void lshift(dynamic_bitset &__bits, size_t __n) const {
+        const auto __size = __bits.size() + __n;
+        const auto __words = __detail::__bitset::div_ceil(__size);
+        if (__bits.size() == 0 || this->is_serial(__words)) { __bits <<= __n; return; }
+        const auto [__div, __mod] = __detail::__bitset::div_mod(__n);
+        const auto __src = __bits.word_data();
+        const auto __cnt = __bits.word_count();
+        dynamic_bitset __temp(__size);
+        const auto __dst = __temp.word_data();
+        this->for_chunks(__dst, __words, [=](size_t, size_t __beg, size_t __end) {
+            for (size_t i = __beg ; i != __end ; ++i)
+                __dst[i] = __detail::__bitset::shl_word(__src, __cnt, i, __div, __mod);
+        });
+        __detail::__bitset::validate(__dst, __size);
+        __bits.swap(__temp);
+    }
+
+    /* Same as __bits >>= __n, which shrinks the length by __n. */
+    void rshift(dynamic_bitset &__bits, size_t __n) const {
+        if (__n >= __bits.size()) { __bits.clear(); return; }
+        const auto __size = __bits.size() - __n;
+        const auto __words = __detail::__bitset::div_ceil(__size);
+        if (this->is_serial(__words)) { __bits >>= __n; return; }
+        const auto [__div, __mod] = __detail::__bitset::div_mod(__n);
+        const auto __src = __bits.word_data();
+        const auto __cnt = __bits.word_count();
+        dynamic_bitset __temp(__size);
+        const auto __dst = __temp.word_data();
+        this->for_chunks(__dst, __words, [=](size_t, size_t __beg, size_t __end) {
+            for (size_t i = __beg ; i != __end ; ++i)
+                __dst[i] = __detail::__bitset::shr_word(__src, __cnt, i, __div, __mod);
+        });
+        __detail::__bitset::validate(__dst, __size);
+        __bits.swap(__temp);
+    }
+};
+
+
+} // namespace dark
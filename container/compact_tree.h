@@ -0,0 +1,416 @@
+#pragma once
+#include "tree.h"
+#include "allocator.h"
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+namespace dark {
+
+
+namespace __detail::__compact {
+
+using __tree::Color;
+using __tree::Direction;
+using __tree::WHITE;
+using __tree::BLACK;
+using __tree::LT;
+using __tree::RT;
+
+/* Index of no node. */
+inline constexpr uint32_t __Nil = -1;
+/* Most nodes in one arena, header included: sizes have 31 bits. */
+inline constexpr size_t __MaxNodes = size_t{1} << 31;
+
+/**
+ * Tree node with 32-bit links: half the size of __tree::node.
+ * Links are indices into the arena that holds the node.
+ */
+struct node {
+    uint32_t parent;    // Parent index.
+    uint32_t child[2];  // Left and right child index.
+    uint32_t info;      // Color in bit 0, subtree size above it.
+};
+
+static_assert(sizeof(node) == 16);
+
+template <typename _Node> struct handle;
+template <typename _Node> struct view;
+
+/* A link field, read and written as a handle. */
+template <typename _Node>
+struct link_ref {
+    _Node *     base;
+    uint32_t *  slot;
+
+    constexpr operator handle <_Node> () const { return { base, *slot }; }
+    constexpr link_ref &operator = (handle <_Node> __ptr) { *slot = __ptr.index; return *this; }
+    constexpr link_ref &operator = (const link_ref &__rhs) { return *this = handle <_Node> (__rhs); }
+    constexpr view <_Node> operator ->() const { return { base, *slot }; }
+
+    friend constexpr bool operator == (const link_ref &__lhs, handle <_Node> __rhs) {
+        return *__lhs.slot == __rhs.index;
+    }
+};
+
+/* The color bit of a packed info field. */
+struct color_ref {
+    uint32_t *info;
+
+    constexpr operator Color() const { return static_cast <Color> (*info & 1); }
+    constexpr color_ref &operator = (Color __c) { *info = (*info & ~1u) | __c; return *this; }
+    constexpr color_ref &operator = (const color_ref &__rhs) { return *this = Color(__rhs); }
+};
+
+/* The size bits of a packed info field. */
+struct size_ref {
+    uint32_t *info;
+
+    constexpr operator unsigned() const { return *info >> 1; }
+    constexpr size_ref &operator = (size_t __n) { *info = uint32_t(__n << 1) | (*info & 1); return *this; }
+    constexpr size_ref &operator = (const size_ref &__rhs) { return *this = size_t(unsigned(__rhs)); }
+    constexpr size_ref &operator ++() { *info += 2; return *this; }
+    constexpr size_ref &operator --() { *info -= 2; return *this; }
+};
+
+/* Fields of one node, as the tree algorithms see them through ->. */
+template <typename _Node>
+struct view {
+    _Node *             base;
+    uint32_t            index;
+    link_ref <_Node>    parent;
+    link_ref <_Node>    child[2];
+    color_ref           color;
+    size_ref            size;
+
+    constexpr view(_Node *__base, uint32_t __index)
+        : base(__base), index(__index),
+          parent    {__base, &__base[__index].parent},
+          child     {{__base, &__base[__index].child[0]}, {__base, &__base[__index].child[1]}},
+          color     {&__base[__index].info},
+          size      {&__base[__index].info} {}
+
+    constexpr view *operator ->() { return this; }
+
+    /* Return whether the node is root or header. */
+    constexpr bool is_special() const {
+        return base[base[index].parent].parent == index;
+    }
+    /* Return whether the node is header. */
+    constexpr bool is_header() const {
+        return this->is_special() && Color(color) == WHITE;
+    }
+    /* Update parent's children and return parent. */
+    constexpr handle <_Node> update_parent(handle <_Node> __next) {
+        const auto __up = base[index].parent;
+        auto &__head = base[__up];
+        if (__head.parent == index) // Parent is header.
+            __head.parent = __next.index;
+        else
+            __head.child[__head.child[0] != index] = __next.index;
+        return { base, __up };
+    }
+};
+
+/* Node handle: arena and index. Plays the role of node * in tree.h. */
+template <typename _Node>
+struct handle {
+    _Node *     base;   // Arena
+    uint32_t    index;  // Slot in the arena, __Nil for null
+
+    constexpr handle(std::nullptr_t = nullptr) : base(), index(__Nil) {}
+    constexpr handle(_Node *__base, uint32_t __index) : base(__base), index(__index) {}
+
+    constexpr view <_Node> operator ->() const { return { base, index }; }
+
+    friend constexpr bool operator == (handle __lhs, handle __rhs) { return __lhs.index == __rhs.index; }
+};
+
+template <typename _Tp>
+using value_node = __node::value_node <_Tp, node>;
+
+} // namespace __detail::__compact
+
+
+/**
+ * Ordered set of unique keys on compact nodes, with O(log n) rank and
+ * select. Nodes live in one arena and link by 32-bit index, so a node
+ * takes 16 bytes plus the value instead of 32. The rebalancing is the
+ * same code as rb_set, from tree.h, run on index handles. The arena
+ * grows by realloc, so values must be trivial. Iterators stay valid
+ * across inserts, moves and swaps, as in std::set; references to
+ * values do not survive an insert.
+ */
+template <typename _Tp, typename _Compare = std::less <_Tp>>
+struct compact_set {
+  private:
+    using _Node_t   = __detail::__compact::value_node <_Tp>;
+    using _Ptr      = __detail::__compact::handle <_Node_t>;
+    using _Alloc_t  = allocator <_Node_t>;
+
+    static_assert(std::is_trivial_v <_Tp>, "compact_set only supports trivial types now.");
+
+    static constexpr uint32_t __Nil = __detail::__compact::__Nil;
+
+  public:
+    struct const_iterator {
+      public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type        = _Tp;
+        using difference_type   = ptrdiff_t;
+        using pointer           = const _Tp *;
+        using reference         = const _Tp &;
+
+        _Node_t *const *arena {};   // Cell holding the arena, so growth and moves are seen
+        uint32_t        index {};   // Current node, 0 (header) for end()
+
+        reference operator *() const { return (*arena)[index].value; }
+        pointer  operator ->() const { return &**this; }
+
+        const_iterator &operator ++() {
+            index = __detail::__tree::advance <__detail::__tree::RT> (_Ptr {*arena, index}).index;
+            return *this;
+        }
+        const_iterator &operator --() {
+            const _Ptr __cur {*arena, index};
+            /* Header keeps the rightmost node in child[RT]. */
+            index = __cur->is_header() ? (*arena)[index].child[1]
+                  : __detail::__tree::advance <__detail::__tree::LT> (__cur).index;
+            return *this;
+        }
+        const_iterator operator ++(int) { auto __tmp = *this; ++*this; return __tmp; }
+        const_iterator operator --(int) { auto __tmp = *this; --*this; return __tmp; }
+
+        friend bool operator == (const_iterator, const_iterator) = default;
+    };
+
+    using key_type          = _Tp;
+    using value_type        = _Tp;
+    using size_type         = size_t;
+    using key_compare       = _Compare;
+    using iterator          = const_iterator;
+    using reverse_iterator       = std::reverse_iterator <iterator>;
+    using const_reverse_iterator = std::reverse_iterator <const_iterator>;
+
+  private:
+    _Node_t *   arena;  // Slot 0 is the header
+    std::unique_ptr <_Node_t *> home; // Copy of arena for iterators, moves with it
+    uint32_t    used;   // Slots ever handed out
+    uint32_t    cap;    // Slots allocated
+    uint32_t    free;   // Head of freed slots, linked by parent
+    [[no_unique_address]] _Compare comp;
+
+    _Ptr at(uint32_t __n) const { return { arena, __n }; }
+    _Ptr head() const { return this->at(0); }
+    uint32_t root() const { return arena == nullptr ? __Nil : arena[0].parent; }
+    const _Tp &key(uint32_t __n) const { return arena[__n].value; }
+    const_iterator make_iter(uint32_t __n) const { return { home.get(), __n }; }
+
+    void reset() {
+        arena[0].parent = __Nil;
+        arena[0].child[0] = arena[0].child[1] = 0;
+        arena[0].info = 0; // White header.
+        used = 1;
+        free = __Nil;
+    }
+
+    void grow(size_t __n) {
+        if (__n > __detail::__compact::__MaxNodes)
+            throw std::length_error("compact_set: Too many elements.");
+        const bool __fresh = arena == nullptr;
+        if (home == nullptr) home = std::make_unique <_Node_t *> (); // Moved from.
+        arena = _Alloc_t::reallocate(arena, cap, __n);
+        cap   = static_cast <uint32_t> (__n);
+        *home = arena;
+        if (__fresh) this->reset();
+    }
+
+    uint32_t make_slot(const _Tp &__val) {
+        uint32_t __n;
+        if (free != __Nil) {
+            __n  = free;
+            free = arena[__n].parent;
+        } else {
+            if (used == cap) this->grow(std::max <size_t> (16, size_t(cap) * 2));
+            __n = used++;
+        }
+        arena[__n].value = __val;
+        return __n;
+    }
+
+    void drop_slot(uint32_t __n) {
+        arena[__n].parent = free;
+        free = __n;
+    }
+
+    /* Same as rb_tree::locate, on indices. __Nil for no equal node. */
+    struct slot { uint32_t parent; __detail::__tree::Direction dir; uint32_t equal; };
+    slot locate(const _Tp &__key) const {
+        uint32_t __parent = 0;
+        uint32_t __lower  = __Nil;
+        bool     __dir    = false;
+        __detail::__tree::search_probe __probe;
+        for (auto __cur = this->root() ; __cur != __Nil ; __cur = arena[__cur].child[__dir]) {
+            __probe.step();
+            __parent = __cur;
+            __dir = comp(key(__cur), __key);
+            if (!__dir) __lower = __cur;
+        }
+        const auto __d = static_cast <__detail::__tree::Direction> (__dir);
+        if (__lower != __Nil && !comp(__key, key(__lower))) return { __parent, __d, __lower };
+        return { __parent, __d, __Nil };
+    }
+
+    template <bool _Upper>
+    uint32_t bound(const _Tp &__key) const {
+        uint32_t __ret = 0;
+        __detail::__tree::search_probe __probe;
+        for (auto __cur = this->root() ; __cur != __Nil ;) {
+            __probe.step();
+            const bool __go_left = _Upper ? comp(__key, key(__cur)) : !comp(key(__cur), __key);
+            if (__go_left) __ret = __cur;
+            __cur = arena[__cur].child[!__go_left];
+        }
+        return __ret;
+    }
+
+    void erase_slot(uint32_t __n) {
+        __detail::__tree::erase_at(this->head(), this->at(__n));
+        this->drop_slot(__n);
+    }
+
+  public:
+    compact_set() : arena(), home(std::make_unique <_Node_t *> ()), used(), cap(), free(__Nil) {}
+    explicit compact_set(const _Compare &__comp) : compact_set() { comp = __comp; }
+
+    compact_set(const compact_set &__rhs)
+        : arena(), home(std::make_unique <_Node_t *> ()),
+          used(__rhs.used), cap(), free(__rhs.free), comp(__rhs.comp) {
+        if (__rhs.arena == nullptr) return;
+        arena = _Alloc_t::allocate(__rhs.used);
+        cap   = __rhs.used;
+        std::copy_n(__rhs.arena, __rhs.used, arena);
+        *home = arena;
+    }
+    compact_set(compact_set &&__rhs) noexcept
+        : arena(std::exchange(__rhs.arena, nullptr)), home(std::move(__rhs.home)),
+          used(std::exchange(__rhs.used, 0)),
+          cap(std::exchange(__rhs.cap, 0)), free(std::exchange(__rhs.free, __Nil)),
+          comp(std::move(__rhs.comp)) {}
+
+    compact_set &operator = (const compact_set &__rhs) {
+        if (this != &__rhs) { compact_set __tmp(__rhs); this->swap(__tmp); }
+        return *this;
+    }
+    compact_set &operator = (compact_set &&__rhs) noexcept {
+        if (this != &__rhs) { compact_set __tmp(std::move(__rhs)); this->swap(__tmp); }
+        return *this;
+    }
+
+    ~compact_set() { _Alloc_t::deallocate(arena, cap); }
+
+    void swap(compact_set &__rhs) noexcept {
+        std::swap(arena, __rhs.arena);
+        std::swap(home, __rhs.home);
+        std::swap(used, __rhs.used);
+        std::swap(cap, __rhs.cap);
+        std::swap(free, __rhs.free);
+        std::swap(comp, __rhs.comp);
+    }
+
+    void clear() { if (arena != nullptr) this->reset(); }
+
+    /* Make room for __n elements without growing the arena. */
+    void reserve(size_t __n) { if (__n + 1 > cap) this->grow(__n + 1); }
+
+    size_t size()  const { return this->root() == __Nil ? 0 : arena[this->root()].info >> 1; }
+    bool   empty() const { return this->root() == __Nil; }
+    /* Number of elements the arena holds before growing. */
+    size_t capacity() const { return cap == 0 ? 0 : cap - 1; }
+
+    const_iterator begin() const { return this->make_iter(arena == nullptr ? 0 : arena[0].child[0]); }
+    const_iterator end()   const { return this->make_iter(0); }
+    const_iterator cbegin() const { return this->begin(); }
+    const_iterator cend()   const { return this->end(); }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator {this->end()}; }
+    const_reverse_iterator rend()   const { return const_reverse_iterator {this->begin()}; }
+
+    key_compare key_comp() const { return comp; }
+
+  public:
+    /* Section of lookups. */
+
+    const_iterator find(const _Tp &__key) const {
+        const auto __n = this->bound <false> (__key);
+        if (__n == 0 || comp(__key, key(__n))) return this->end();
+        return this->make_iter(__n);
+    }
+
+    bool   contains(const _Tp &__key) const { return this->find(__key) != this->end(); }
+    size_t count(const _Tp &__key) const { return this->contains(__key); }
+
+    const_iterator lower_bound(const _Tp &__key) const { return this->make_iter(this->bound <false> (__key)); }
+    const_iterator upper_bound(const _Tp &__key) const { return this->make_iter(this->bound <true>  (__key)); }
+
+    /* Number of elements less than __key. */
+    size_t rank(const _Tp &__key) const {
+        size_t __ret = 0;
+        for (auto __cur = this->root() ; __cur != __Nil ;) {
+            const auto &__node = arena[__cur];
+            if (comp(key(__cur), __key)) {
+                __ret += __detail::__tree::size_of(this->at(__node.child[0])) + 1;
+                __cur  = __node.child[1];
+            } else {
+                __cur  = __node.child[0];
+            }
+        }
+        return __ret;
+    }
+
+    /* Number of elements before __pos. rank(end()) == size(). */
+    size_t rank(const_iterator __pos) const {
+        return __pos.index == 0 ? this->size() : __detail::__tree::index_of(this->at(__pos.index));
+    }
+
+    /* The __k-th (0-indexed) smallest element, or end() if __k >= size(). */
+    const_iterator select(size_t __k) const {
+        if (__k >= this->size()) return this->end();
+        return this->make_iter(__detail::__tree::select(this->at(this->root()), __k).index);
+    }
+
+  public:
+    /* Section of modifiers. */
+
+    std::pair <const_iterator, bool> insert(const _Tp &__val) {
+        const auto [__parent, __dir, __equal] = this->locate(__val);
+        if (__equal != __Nil) return { this->make_iter(__equal), false };
+        const auto __n = this->make_slot(__val); // May move the arena.
+        __detail::__tree::insert_at(this->head(), this->at(__parent), __dir, this->at(__n));
+        return { this->make_iter(__n), true };
+    }
+
+    template <typename _Iter>
+    void insert(_Iter __first, _Iter __last) {
+        for (; __first != __last ; ++__first) this->insert(*__first);
+    }
+
+    /* Erase the element at __pos, return the next one. */
+    const_iterator erase(const_iterator __pos) {
+        const auto __next = std::next(__pos);
+        this->erase_slot(__pos.index);
+        return __next;
+    }
+
+    size_t erase(const _Tp &__key) {
+        const auto __pos = this->find(__key);
+        if (__pos == this->end()) return 0;
+        this->erase_slot(__pos.index);
+        return 1;
+    }
+};
+
+
+} // namespace dark
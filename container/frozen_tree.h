@@ -0,0 +1,158 @@
+#pragma once
+#include "tree.h"
+#include <functional>
+#include <stdexcept>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <bit>
+#include <new>
+
+namespace dark {
+
+
+namespace __detail::__frozen {
+
+/* Bytes per cache line. */
+inline constexpr size_t __Line = 64;
+
+/* Allocates on cache line boundaries. */
+template <typename _Tp>
+struct line_allocator {
+    using value_type = _Tp;
+
+    line_allocator() = default;
+    template <typename _Up>
+    line_allocator(const line_allocator <_Up> &) {}
+
+    static _Tp *allocate(size_t __n) {
+        return static_cast <_Tp *> (::operator new(__n * sizeof(_Tp), std::align_val_t {__Line}));
+    }
+    static void deallocate(_Tp *__ptr, size_t) {
+        ::operator delete(__ptr, std::align_val_t {__Line});
+    }
+
+    friend bool operator == (line_allocator, line_allocator) { return true; }
+};
+
+/**
+ * Keys in one cache line: the descendants of k that many levels down
+ * sit at [k * __Fan, k * __Fan + __Fan). 0 if a key spans a line.
+ */
+template <typename _Key>
+inline constexpr size_t __Fan = sizeof(_Key) <= __Line ? std::bit_floor(__Line / sizeof(_Key)) : 0;
+
+/**
+ * Immutable sorted snapshot for read-mostly lookups.
+ * Keys are copied into Eytzinger (BFS) order from index 1, so a search
+ * touches one array front to back, and its top levels stay in cache.
+ * Each step is k = 2k + (key < x), with no branch to mispredict, and
+ * the line holding the descendants a few levels down is prefetched.
+ * Values stay in sorted order for select and iteration; order maps an
+ * Eytzinger index back to the sorted position.
+ */
+template <typename _Tp, typename _Key, typename _KeyOf, typename _Compare>
+struct frozen_tree {
+  public:
+    using key_type          = _Key;
+    using value_type        = _Tp;
+    using size_type         = size_t;
+    using key_compare       = _Compare;
+    using const_reference   = const _Tp &;
+    using const_iterator    = const _Tp *;
+    using iterator          = const_iterator;
+
+  private:
+    std::vector <_Key, line_allocator <_Key>> keys; // Eytzinger order, [0] unused
+    std::vector <uint32_t>  order;  // Eytzinger index -> sorted position
+    std::vector <_Tp>       values; // Sorted order
+    [[no_unique_address]] _Compare comp;
+
+    /* Sorted position of each node of the implicit tree, in order. */
+    void number(size_t __k, uint32_t &__next) {
+        if (__k > values.size()) return;
+        this->number(__k * 2, __next);
+        order[__k] = __next++;
+        this->number(__k * 2 + 1, __next);
+    }
+
+    /* Sorted position of the first key with !comp(key, __key) (or comp(__key, key)). */
+    template <bool _Upper>
+    size_t search(const _Key &__key) const {
+        constexpr auto __fan = __Fan <_Key>;
+        const auto *__base = keys.data();
+        const auto __n = values.size();
+        size_t __k = 1;
+        while (__k <= __n) {
+            if constexpr (__fan != 0) __builtin_prefetch(__base + __k * __fan);
+            if constexpr (_Upper) __k = __k * 2 + !comp(__key, __base[__k]);
+            else                  __k = __k * 2 + comp(__base[__k], __key);
+        }
+        /* Undo the right turns after the last left one: that node is the answer. */
+        __k >>= std::countr_one(__k) + 1;
+        return __k == 0 ? __n : order[__k];
+    }
+
+  public:
+    frozen_tree() = default;
+
+    /* Snapshot of [__first, __last), whose keys must be strictly increasing. */
+    template <typename _Iter>
+    frozen_tree(_Iter __first, _Iter __last, const _Compare &__comp = _Compare {})
+        : values(__first, __last), comp(__comp) {
+        const auto __n = values.size();
+        if (__n == 0) return;
+        if (__n >= (size_t{1} << 32))
+            throw std::invalid_argument("frozen_tree: Too many elements.");
+        order.resize(__n + 1);
+        uint32_t __next = 0;
+        this->number(1, __next);
+        keys.reserve(__n + 1);
+        keys.push_back(_KeyOf {} (values[0])); // Never compared.
+        for (size_t k = 1 ; k <= __n ; ++k)
+            keys.push_back(_KeyOf {} (values[order[k]]));
+    }
+
+    size_t size()  const { return values.size(); }
+    bool   empty() const { return values.empty(); }
+
+    const_iterator begin() const { return values.data(); }
+    const_iterator end()   const { return values.data() + values.size(); }
+
+    key_compare key_comp() const { return comp; }
+
+    /* Number of elements less than __key. */
+    size_t rank(const _Key &__key) const { return this->search <false> (__key); }
+
+    /* The __k-th (0-indexed) smallest element, or end() if __k >= size(). */
+    const_iterator select(size_t __k) const {
+        return __k >= this->size() ? this->end() : this->begin() + __k;
+    }
+
+    const_iterator lower_bound(const _Key &__key) const { return this->begin() + this->search <false> (__key); }
+    const_iterator upper_bound(const _Key &__key) const { return this->begin() + this->search <true>  (__key); }
+
+    const_iterator find(const _Key &__key) const {
+        const auto __pos = this->lower_bound(__key);
+        if (__pos == this->end() || comp(__key, _KeyOf {} (*__pos))) return this->end();
+        return __pos;
+    }
+
+    bool   contains(const _Key &__key) const { return this->find(__key) != this->end(); }
+    size_t count(const _Key &__key) const { return this->contains(__key); }
+};
+
+} // namespace __detail::__frozen
+
+
+/* Read-only snapshot of an rb_set, from rb_set::freeze(). */
+template <typename _Tp, typename _Compare = std::less <_Tp>>
+using frozen_set = __detail::__frozen::frozen_tree <_Tp, _Tp, __detail::__tree::key_self, _Compare>;
+
+/* Read-only snapshot of an rb_map, from rb_map::freeze(). */
+template <typename _Key, typename _Val, typename _Compare = std::less <_Key>>
+using frozen_map = __detail::__frozen::frozen_tree <
+    std::pair <const _Key, _Val>, _Key, __detail::__tree::key_first, _Compare>;
+
+
+} // namespace dark
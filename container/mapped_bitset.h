@@ -0,0 +1,366 @@
+#pragma once
+#include "bitset.h"
+#include "rank_select.h"
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <memory>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace dark {
+
+
+namespace __detail::__mapped {
+
+using __bitset::_Word_t;
+
+inline constexpr char       __Magic[8]  = {'D', 'K', 'B', 'I', 'T', 'S', 'E', 'T'};
+inline constexpr uint32_t   __Version   = 1;
+/* Every array starts on a cache line. */
+inline constexpr size_t     __Align     = 64;
+
+enum : uint32_t {
+    HAS_RANK = 1,   // Rank index is stored after the words
+};
+
+/**
+ * File layout, in native (little) endian:
+ * header, then the word array, then (if HAS_RANK) the
+ * upper, entry and hints arrays of rank_select.
+ * Offsets are in bytes from the start of the file.
+ */
+struct header {
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    flags;
+    uint64_t    file_size;  // Total bytes, for validation
+    uint64_t    length;     // Number of bits
+    uint64_t    ones;       // Number of 1 bits
+    uint64_t    words_off;
+    uint64_t    upper_off;
+    uint64_t    upper_cnt;
+    uint64_t    entry_off;
+    uint64_t    entry_cnt;
+    uint64_t    hints_off;
+    uint64_t    hints_cnt;
+};
+
+inline constexpr uint64_t align_up(uint64_t __n) {
+    return (__n + __Align - 1) / __Align * __Align;
+}
+
+/* Whether [__off, __off + __cnt * __size) is an aligned range in the file. */
+inline constexpr bool in_file(uint64_t __off, uint64_t __cnt, uint64_t __size, uint64_t __file) {
+    return __off % __Align == 0 && __off <= __file && __cnt <= (__file - __off) / __size;
+}
+
+/* Write __n bytes, then pad with zeros to the alignment. */
+inline void write_aligned(std::FILE *__fp, const void *__src, size_t __n) {
+    static constexpr char __zero[__Align] = {};
+    if (std::fwrite(__src, 1, __n, __fp) != __n
+    ||  std::fwrite(__zero, 1, align_up(__n) - __n, __fp) != align_up(__n) - __n)
+        throw std::runtime_error("save_bitset: Write failed.");
+}
+
+} // namespace __detail::__mapped
+
+
+/**
+ * Save a bitset to __path in the mapped_bitset format.
+ * With __rank, a rank_select index is built and stored too.
+ * Throw std::runtime_error on any I/O error.
+ */
+inline void save_bitset(const char *__path, const dynamic_bitset &__bits, bool __rank = false) {
+    using namespace __detail::__mapped;
+    const auto __words = __bits.word_count() * sizeof(_Word_t);
+
+    header __head {};
+    std::memcpy(__head.magic, __Magic, sizeof(__Magic));
+    __head.version   = __Version;
+    __head.length    = __bits.size();
+    __head.ones      = __bits.count();
+    __head.words_off = align_up(sizeof(header));
+    __head.file_size = __head.words_off + align_up(__words);
+
+    rank_select __index;
+    if (__rank) {
+        __index = rank_select(__bits);
+        __head.flags    |= HAS_RANK;
+        __head.upper_cnt = __index.upper_data().size();
+        __head.entry_cnt = __index.entry_data().size();
+        __head.hints_cnt = __index.hints_data().size();
+        __head.upper_off = __head.file_size;
+        __head.entry_off = __head.upper_off + align_up(__head.upper_cnt * sizeof(_Word_t));
+        __head.hints_off = __head.entry_off + align_up(__head.entry_cnt * sizeof(_Word_t));
+        __head.file_size = __head.hints_off + align_up(__head.hints_cnt * sizeof(uint32_t));
+    }
+
+    struct closer { void operator()(std::FILE *__fp) const { std::fclose(__fp); } };
+    const auto __fp = std::fopen(__path, "wb");
+    if (!__fp) throw std::runtime_error("save_bitset: Cannot open file.");
+    const std::unique_ptr <std::FILE, closer> __guard {__fp};
+
+    write_aligned(__fp, &__head, sizeof(header));
+    write_aligned(__fp, __bits.word_data(), __words);
+    if (__rank) {
+        write_aligned(__fp, __index.upper_data().data(), __head.upper_cnt * sizeof(_Word_t));
+        write_aligned(__fp, __index.entry_data().data(), __head.entry_cnt * sizeof(_Word_t));
+        write_aligned(__fp, __index.hints_data().data(), __head.hints_cnt * sizeof(uint32_t));
+    }
+    if (std::fflush(__fp) != 0)
+        throw std::runtime_error("save_bitset: Write failed.");
+}
+
+
+/**
+ * Read-only view of a bitset file written by save_bitset.
+ * The file is mapped, not read, so opening costs the same
+ * for any size; pages are loaded on first access. Opening
+ * checks the header only: count() trusts the stored count,
+ * and verify() checks it and the rank index against the words.
+ * Queries stay inside the mapping even if the file is corrupt,
+ * but then their answers are not meaningful.
+ * All queries run directly on the mapping.
+ */
+struct mapped_bitset {
+  private:
+    using _Word_t   = __detail::__bitset::_Word_t;
+    using _Header_t = __detail::__mapped::header;
+
+    void *          base;   // Start of the mapping
+    size_t          bytes;  // Size of the mapping
+    const _Word_t * words;  // Word array in the mapping
+    size_t          length; // Number of bits
+    size_t          total;  // Number of 1 bits
+
+    __detail::__rank::rank_view index; // Null arrays if no rank stored
+
+    [[noreturn]] void fail(const char *__msg) {
+        this->unmap();
+        throw std::runtime_error(__msg);
+    }
+
+    void unmap() noexcept {
+        if (base) ::munmap(base, bytes);
+        base = nullptr;
+    }
+
+    template <typename _Tp>
+    const _Tp *at_offset(uint64_t __off) const {
+        return reinterpret_cast <const _Tp *> (static_cast <const char *> (base) + __off);
+    }
+
+    /* Check the header against the file, and set up the pointers. */
+    void validate() {
+        using namespace __detail::__mapped;
+        if (bytes < sizeof(_Header_t)) this->fail("mapped_bitset: File too small.");
+
+        const auto &__head = *this->at_offset <_Header_t> (0);
+        if (std::memcmp(__head.magic, __Magic, sizeof(__Magic)) != 0)
+            this->fail("mapped_bitset: Bad magic.");
+        if (__head.version != __Version)
+            this->fail("mapped_bitset: Unsupported version.");
+        if (__head.file_size != bytes)
+            this->fail("mapped_bitset: Bad file size.");
+        if (__head.flags & ~uint32_t(HAS_RANK))
+            this->fail("mapped_bitset: Unknown flags.");
+
+        /* Bound the length by the file first, so the word count cannot wrap. */
+        if (__head.words_off > bytes || __head.length / 8 > bytes - __head.words_off)
+            this->fail("mapped_bitset: Bad length.");
+        const auto __words = __detail::__bitset::div_ceil(__head.length);
+        if (!in_file(__head.words_off, __words, sizeof(_Word_t), bytes))
+            this->fail("mapped_bitset: Bad word array.");
+
+        words  = this->at_offset <_Word_t> (__head.words_off);
+        length = __head.length;
+        total  = __head.ones;
+        index  = {};
+
+        /* Bits past the length must be 0, or searches return them. */
+        if (const auto __mod = length % __detail::__bitset::__WBits;
+            __mod != 0 && (words[__words - 1] & ~__detail::__bitset::mask_low(__mod)) != 0)
+            this->fail("mapped_bitset: Bad padding.");
+
+        if (total > length) this->fail("mapped_bitset: Bad count.");
+        if (!(__head.flags & HAS_RANK)) return;
+
+        using namespace __detail::__rank;
+        const auto __super = (__words + __SWords - 1) / __SWords;
+        if (__head.entry_cnt != __super + 1
+        ||  __head.upper_cnt != __super / __USuper + 1
+        ||  __head.hints_cnt != (total + __Hint - 1) / __Hint + 1
+        ||  !in_file(__head.upper_off, __head.upper_cnt, sizeof(_Word_t), bytes)
+        ||  !in_file(__head.entry_off, __head.entry_cnt, sizeof(_Word_t), bytes)
+        ||  !in_file(__head.hints_off, __head.hints_cnt, sizeof(uint32_t), bytes))
+            this->fail("mapped_bitset: Bad rank index.");
+
+        index = {
+            words, length, total,
+            this->at_offset <_Word_t>   (__head.upper_off),
+            this->at_offset <_Word_t>   (__head.entry_off),
+            this->at_offset <uint32_t>  (__head.hints_off),
+        };
+    }
+
+  public:
+    inline static constexpr size_t npos = -1;
+
+    mapped_bitset() noexcept : base(), bytes(), words(), length(), total(), index() {}
+
+    /* Map the file at __path. Throw std::runtime_error if it is not valid. */
+    explicit mapped_bitset(const char *__path) : mapped_bitset() {
+        const int __fd = ::open(__path, O_RDONLY | O_CLOEXEC);
+        if (__fd < 0) throw std::runtime_error("mapped_bitset: Cannot open file.");
+
+        struct stat __st;
+        if (::fstat(__fd, &__st) != 0) {
+            ::close(__fd);
+            throw std::runtime_error("mapped_bitset: Cannot stat file.");
+        }
+
+        bytes = size_t(__st.st_size);
+        auto __ptr = bytes ? ::mmap(nullptr, bytes, PROT_READ, MAP_SHARED, __fd, 0) : MAP_FAILED;
+        ::close(__fd); // The mapping keeps the file alive.
+        if (__ptr == MAP_FAILED) throw std::runtime_error("mapped_bitset: Cannot map file.");
+
+        base = __ptr;
+        this->validate();
+    }
+
+    mapped_bitset(const mapped_bitset &) = delete;
+    mapped_bitset &operator = (const mapped_bitset &) = delete;
+
+    mapped_bitset(mapped_bitset &&__rhs) noexcept
+        : base(std::exchange(__rhs.base, nullptr)), bytes(__rhs.bytes),
+          words(__rhs.words), length(__rhs.length), total(__rhs.total), index(__rhs.index) {}
+
+    mapped_bitset &operator = (mapped_bitset &&__rhs) noexcept {
+        if (this != &__rhs) {
+            this->unmap();
+            base   = std::exchange(__rhs.base, nullptr);
+            bytes  = __rhs.bytes;
+            words  = __rhs.words;
+            length = __rhs.length;
+            total  = __rhs.total;
+            index  = __rhs.index;
+        }
+        return *this;
+    }
+
+    ~mapped_bitset() { this->unmap(); }
+
+  public:
+    size_t size()  const { return length; }
+    /* Number of 1 bits, read from the header. */
+    size_t count() const { return total; }
+
+    bool any()  const { return total != 0; }
+    bool none() const { return total == 0; }
+    bool all()  const { return total == length; }
+
+    bool test(size_t __n) const {
+        auto [__div, __mod] = __detail::__bitset::div_mod(__n);
+        return (words[__div] >> __mod) & 1;
+    }
+    bool operator [] (size_t __n) const { return this->test(__n); }
+    bool at(size_t __n) const {
+        if (__n >= length) throw std::out_of_range("mapped_bitset::at");
+        return this->test(__n);
+    }
+
+    /* Number of words. */
+    size_t word_count() const { return __detail::__bitset::div_ceil(length); }
+    /* Raw words in the mapping. Unused bits of the last word are 0. */
+    const _Word_t *word_data() const { return words; }
+
+    /* Return the index of the first 1 bit, or npos if none. */
+    size_t find_first() const {
+        return __detail::__bitset::find_next(words, length, 0);
+    }
+    /* Return the index of the first 1 bit after __n, or npos if none. */
+    size_t find_next(size_t __n) const {
+        if (__n == npos) return npos;
+        return __detail::__bitset::find_next(words, length, __n + 1);
+    }
+    /* Return the index of the last 1 bit, or npos if none. */
+    size_t find_last() const {
+        return __detail::__bitset::find_prev(words, length, npos);
+    }
+    /* Return the index of the last 1 bit before __n, or npos if none. */
+    size_t find_prev(size_t __n) const {
+        if (__n == 0) return npos;
+        return __detail::__bitset::find_prev(words, length, __n - 1);
+    }
+
+    /* Range of indices of 1 bits, for use in range-for. */
+    auto ones() const {
+        return __detail::__bitset::one_range {words, this->word_count()};
+    }
+
+    /* Write indices of all 1 bits into __out. Return the number written. */
+    size_t extract_indices(uint32_t *__out) const {
+        return __detail::__bitset::extract_indices(__out, words, this->word_count());
+    }
+
+    /**
+     * Whether the stored count and rank index match the words.
+     * Reads the whole file and builds a rank_select to compare with,
+     * so this costs a pass over the words and about 3% extra memory.
+     * The mapping is shared: a later change to the file is not seen.
+     */
+    bool verify() const {
+        if (total != __detail::__bitset::do_count(words, this->word_count())) return false;
+        if (!this->has_rank()) return true;
+
+        const rank_select __check(words, length);
+        const auto __same = [](const auto &__vec, const auto *__ptr) {
+            return std::memcmp(__vec.data(), __ptr, __vec.size() * sizeof(*__ptr)) == 0;
+        };
+        return __same(__check.upper_data(), index.upper)
+            && __same(__check.entry_data(), index.entry)
+            && __same(__check.hints_data(), index.hints);
+    }
+
+    /* Whether the file stores a rank index. */
+    bool has_rank() const { return index.entry != nullptr; }
+    /* Rank/select view on the mapping. Requires has_rank(). */
+    __detail::__rank::rank_view rank_index() const { return index; }
+
+    /* Number of 1 bits in [0, __n). Requires has_rank(). */
+    size_t rank(size_t __n) const { return index.rank(__n); }
+    /* Position of the __k-th (0-indexed) 1 bit, or npos. Requires has_rank(). */
+    size_t select(size_t __k) const { return index.select(__k); }
+
+    /* __dst &= *this, over the common prefix, like dynamic_bitset. */
+    void and_into(dynamic_bitset &__dst) const {
+        const auto __min = std::min(__dst.size(), length);
+        __detail::__bitset::do_and(__dst.word_data(), words, __min);
+    }
+    /* __dst |= *this, over the common prefix, like dynamic_bitset. */
+    void or_into(dynamic_bitset &__dst) const {
+        const auto __min = std::min(__dst.size(), length);
+        __detail::__bitset::do_or_(__dst.word_data(), words, __min);
+    }
+    /* __dst ^= *this, over the common prefix, like dynamic_bitset. */
+    void xor_into(dynamic_bitset &__dst) const {
+        const auto __min = std::min(__dst.size(), length);
+        __detail::__bitset::do_xor(__dst.word_data(), words, __min);
+    }
+
+    /* Copy into an owning bitset. */
+    dynamic_bitset to_bitset() const {
+        dynamic_bitset __ret(length);
+        std::memcpy(__ret.word_data(), words, this->word_count() * sizeof(_Word_t));
+        return __ret;
+    }
+};
+
+
+} // namespace dark
@@ -0,0 +1,204 @@
+#pragma once
+#include "tree.h"
+#include "allocator.h"
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace dark {
+
+
+namespace __detail::__tree {
+
+/* Read-only queries on one version of a persistent tree. Not owning. */
+template <typename _Tp, typename _Compare>
+struct persist_view {
+  protected:
+    pnode *root {};
+    [[no_unique_address]] _Compare comp {};
+
+    static const _Tp &value(const pnode *__x) {
+        return static_cast <const __node::value_node <_Tp, pnode> *> (__x)->value;
+    }
+
+    /* First node with !comp(value, __key) (lower) or comp(__key, value) (upper). */
+    template <bool _Upper>
+    const pnode *bound(const _Tp &__key) const {
+        const pnode *__ret = nullptr;
+        for (const pnode *__cur = root ; __cur != nullptr ;) {
+            const bool __go_left = _Upper ? comp(__key, value(__cur)) : !comp(value(__cur), __key);
+            if (__go_left) __ret = __cur;
+            __cur = __cur->child[!__go_left];
+        }
+        return __ret;
+    }
+
+    template <typename _Fn>
+    static void walk(const pnode *__x, _Fn &__fn) {
+        for (; __x != nullptr ; __x = __x->child[RT]) {
+            walk(__x->child[LT], __fn);
+            __fn(value(__x));
+        }
+    }
+
+  public:
+    persist_view() = default;
+    persist_view(pnode *__root, const _Compare &__comp) : root(__root), comp(__comp) {}
+
+    size_t size()  const { return size_of(root); }
+    bool   empty() const { return root == nullptr; }
+
+    /* Element equal to __key, or nullptr. */
+    const _Tp *find(const _Tp &__key) const {
+        const auto *__x = this->bound <false> (__key);
+        return __x == nullptr || comp(__key, value(__x)) ? nullptr : &value(__x);
+    }
+
+    bool   contains(const _Tp &__key) const { return this->find(__key) != nullptr; }
+    size_t count(const _Tp &__key) const { return this->contains(__key); }
+
+    /* First element not less than __key, or nullptr. */
+    const _Tp *lower_bound(const _Tp &__key) const {
+        const auto *__x = this->bound <false> (__key);
+        return __x == nullptr ? nullptr : &value(__x);
+    }
+    /* First element greater than __key, or nullptr. */
+    const _Tp *upper_bound(const _Tp &__key) const {
+        const auto *__x = this->bound <true> (__key);
+        return __x == nullptr ? nullptr : &value(__x);
+    }
+
+    /* Number of elements less than __key. */
+    size_t rank(const _Tp &__key) const {
+        size_t __ret = 0;
+        for (const pnode *__cur = root ; __cur != nullptr ;) {
+            if (comp(value(__cur), __key)) {
+                __ret += size_of(__cur->child[LT]) + 1;
+                __cur  = __cur->child[RT];
+            } else {
+                __cur  = __cur->child[LT];
+            }
+        }
+        return __ret;
+    }
+
+    /* The __k-th (0-indexed) smallest element, or nullptr if __k >= size(). */
+    const _Tp *select(size_t __k) const {
+        if (__k >= this->size()) return nullptr;
+        return &value(__detail::__tree::select(root, __k));
+    }
+
+    /* Call __fn on each element in order. */
+    template <typename _Fn>
+    void for_each(_Fn &&__fn) const { walk(root, __fn); }
+};
+
+} // namespace __detail::__tree
+
+
+/**
+ * Ordered set with persistent versions, for one writer and any number
+ * of readers. An update copies the search path and shares the rest, so
+ * older versions stay intact; nodes are reference counted and freed by
+ * whichever holder, on whatever thread, lets go last.
+ *
+ * snapshot() takes the current version in O(1): the lock only covers
+ * taking a reference to the root, never a traversal, so readers query
+ * their version without locks while the writer goes on. Updates and
+ * queries on the set itself are for the writer thread only.
+ */
+template <typename _Tp, typename _Compare = std::less <_Tp>, typename _Alloc = allocator <_Tp>>
+struct persistent_set : __detail::__tree::persist_view <_Tp, _Compare> {
+  private:
+    using _View_t   = __detail::__tree::persist_view <_Tp, _Compare>;
+    using _Node_t   = __detail::__node::value_node <_Tp, __detail::__tree::pnode>;
+    using _Alloc_t  = typename _Alloc::template rebind <_Node_t>::other;
+    using _Ops      = __detail::__tree::persist <_Tp, _Alloc_t>;
+    using pnode     = __detail::__tree::pnode;
+
+    static_assert(std::allocator_traits <_Alloc_t>::is_always_equal::value,
+        "persistent_set only supports stateless allocators now.");
+
+    mutable std::mutex lock; // Guards publishing and taking root
+
+    /* Publish __root as the current version. */
+    void publish(pnode *__root) {
+        {
+            std::lock_guard __guard(lock);
+            std::swap(this->root, __root);
+        }
+        _Ops::release(__root);
+    }
+
+    /* Where __key goes below a node: < 0 left, > 0 right, 0 here. */
+    auto where(const _Tp &__key) const {
+        return [this, &__key](const pnode *__x) -> int {
+            if (this->comp(__key, _View_t::value(__x))) return -1;
+            return this->comp(_View_t::value(__x), __key);
+        };
+    }
+
+  public:
+    using key_type      = _Tp;
+    using value_type    = _Tp;
+    using size_type     = size_t;
+    using key_compare   = _Compare;
+
+    /* A version of the set. Holds its nodes alive; safe on any thread. */
+    struct version : _View_t {
+        version() = default;
+        version(const version &__rhs) : _View_t(_Ops::retain(__rhs.root), __rhs.comp) {}
+        version(version &&__rhs) noexcept : _View_t(std::exchange(__rhs.root, nullptr), __rhs.comp) {}
+        version &operator = (version __rhs) noexcept {
+            std::swap(this->root, __rhs.root);
+            std::swap(this->comp, __rhs.comp);
+            return *this;
+        }
+        ~version() { _Ops::release(this->root); }
+
+      private:
+        friend persistent_set;
+        version(pnode *__root, const _Compare &__comp) : _View_t(__root, __comp) {}
+    };
+
+    persistent_set() = default;
+    explicit persistent_set(const _Compare &__comp) : _View_t(nullptr, __comp) {}
+
+    /* Start from a version: O(1), sharing all nodes. */
+    explicit persistent_set(const version &__ver)
+        : _View_t(_Ops::retain(__ver.root), __ver.comp) {}
+
+    persistent_set(const persistent_set &__rhs) : persistent_set(__rhs.snapshot()) {}
+    persistent_set &operator = (const persistent_set &__rhs) {
+        if (this != &__rhs) this->publish(_Ops::retain(__rhs.snapshot().root));
+        return *this;
+    }
+
+    ~persistent_set() { _Ops::release(this->root); }
+
+    /* The current version, in O(1). May be called from any thread. */
+    version snapshot() const {
+        std::lock_guard __guard(lock);
+        return version {_Ops::retain(this->root), this->comp};
+    }
+
+    /* Insert __val if absent. Return whether it was inserted. */
+    bool insert(const _Tp &__val) {
+        if (this->contains(__val)) return false;
+        this->publish(_Ops::insert_root(_Ops::retain(this->root), this->where(__val), __val));
+        return true;
+    }
+
+    /* Erase __key if present. Return the number erased. */
+    size_t erase(const _Tp &__key) {
+        if (!this->contains(__key)) return 0;
+        this->publish(_Ops::erase_root(_Ops::retain(this->root), this->where(__key)));
+        return 1;
+    }
+
+    void clear() { this->publish(nullptr); }
+};
+
+
+} // namespace dark
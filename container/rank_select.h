@@ -0,0 +1,224 @@
+#pragma once
+#include "bitset.h"
+#include <vector>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+namespace dark {
+
+
+namespace __detail::__rank {
+
+using __bitset::_Word_t;
+using __bitset::__WBits;
+
+/* Words per basic block (512 bits). */
+inline constexpr size_t __BWords = 8;
+/* Words per super block (2048 bits). */
+inline constexpr size_t __SWords = __BWords * 4;
+/* Bits per super block. */
+inline constexpr size_t __SBits  = __SWords * __WBits;
+/* Super blocks per upper block (2^32 bits). */
+inline constexpr size_t __USuper = (size_t{1} << 32) / __SBits;
+/* One select hint every __Hint 1 bits. */
+inline constexpr size_t __Hint   = 8192;
+
+/* Bits of each basic block count packed in a super block entry. */
+inline constexpr size_t __LBits  = 10;
+inline constexpr _Word_t __LMask = (_Word_t{1} << __LBits) - 1;
+
+/**
+ * Super block entry (poppy layout):
+ * low 32 bits: 1 bits before this super block, relative to its upper block.
+ * then 3 x 10 bits: 1 bits in the first three basic blocks.
+ */
+inline constexpr _Word_t make_entry(size_t __rel, const size_t (&__cnt)[4]) {
+    return _Word_t(__rel)
+        | _Word_t(__cnt[0]) << (32)
+        | _Word_t(__cnt[1]) << (32 + __LBits)
+        | _Word_t(__cnt[2]) << (32 + __LBits * 2);
+}
+
+/* Count of the __n-th basic block in the entry, __n < 3. */
+inline constexpr size_t entry_count(_Word_t __entry, size_t __n) {
+    return (__entry >> (32 + __LBits * __n)) & __LMask;
+}
+
+/* Position of the __k-th (0-indexed) 1 bit in a word. */
+inline constexpr size_t select_word(_Word_t __word, size_t __k) {
+#ifdef __BMI2__
+    if (!std::is_constant_evaluated())
+        return std::countr_zero(_pdep_u64(_Word_t{1} << __k, __word));
+#endif
+    size_t __pos = 0;
+    for (;;) { // Skip whole bytes first.
+        const auto __cnt = size_t(std::popcount(__word & 0xff));
+        if (__k < __cnt) break;
+        __k -= __cnt; __word >>= 8; __pos += 8;
+    }
+    while (__k--) __word &= __word - 1;
+    return __pos + std::countr_zero(__word);
+}
+
+/**
+ * Rank/select queries over borrowed arrays.
+ * Arrays are built by rank_select, or mapped from a file.
+ */
+struct rank_view {
+    const _Word_t *     bits;   // Words of the bitset
+    size_t              length; // Number of bits
+    size_t              ones;   // Number of 1 bits
+    const _Word_t *     upper;  // 1 bits before each upper block
+    const _Word_t *     entry;  // One entry per super block, plus a sentinel
+    const uint32_t *    hints;  // Super block of every __Hint-th 1 bit, plus a sentinel
+
+    /* 1 bits before super block __n. */
+    size_t super_rank(size_t __n) const {
+        return upper[__n / __USuper] + (entry[__n] & 0xffffffff);
+    }
+
+    /* Number of super blocks, without the sentinel entry. */
+    size_t super_count() const {
+        return (__bitset::div_ceil(length) + __SWords - 1) / __SWords;
+    }
+
+    /* Number of 1 bits in [0, __n). __n is clamped to length. */
+    size_t rank(size_t __n) const {
+        __n = std::min(__n, length);
+        const auto __word  = __n / __WBits;
+        const auto __super = __word / __SWords;
+        const auto __block = __word / __BWords % 4;
+        const auto __entry = entry[__super];
+
+        auto __cnt = super_rank(__super);
+        for (size_t i = 0 ; i != __block ; ++i) __cnt += entry_count(__entry, i);
+
+        const auto __base = __word / __BWords * __BWords;
+        __cnt += __bitset::do_count(bits + __base, __word - __base);
+        if (const auto __mod = __n % __WBits)
+            __cnt += std::popcount(bits[__word] & __bitset::mask_low(__mod));
+        return __cnt;
+    }
+
+    /**
+     * Position of the __k-th (0-indexed) 1 bit, or -1 if __k >= ones.
+     * Hints are clamped to the super blocks and the word scan stops at
+     * the last word, so a corrupt index (e.g. a mapped file) gives a
+     * wrong answer or -1, but never reads past the arrays.
+     */
+    size_t select(size_t __k) const {
+        if (__k >= ones) return size_t(-1);
+
+        /* Binary search the super block between two hints. */
+        const auto __super = this->super_count();
+        size_t __lo = std::min <size_t> (hints[__k / __Hint], __super);
+        size_t __hi = std::min <size_t> (hints[__k / __Hint + 1], __super) + 1;
+        if (__hi <= __lo) __hi = __lo + 1;
+        while (__hi - __lo > 1) {
+            const auto __mid = (__lo + __hi) / 2;
+            if (super_rank(__mid) <= __k) __lo = __mid;
+            else                          __hi = __mid;
+        }
+
+        /* Step through basic blocks, then words. */
+        const auto __entry = entry[__lo];
+        auto __rest = __k - super_rank(__lo);
+        auto __word = __lo * __SWords;
+        for (size_t i = 0 ; i != 3 ; ++i) {
+            const auto __cnt = entry_count(__entry, i);
+            if (__rest < __cnt) break;
+            __rest -= __cnt;
+            __word += __BWords;
+        }
+        for (const auto __words = __bitset::div_ceil(length) ; __word < __words ; ++__word) {
+            const auto __cnt = size_t(std::popcount(bits[__word]));
+            if (__rest < __cnt) return __word * __WBits + select_word(bits[__word], __rest);
+            __rest -= __cnt;
+        }
+        return size_t(-1);
+    }
+};
+
+} // namespace __detail::__rank
+
+
+/**
+ * Immutable rank/select index over the words of a bitset.
+ * Space overhead is about 3% (one word per 2048 bits, plus hints).
+ * The bitset must outlive the index and must not be modified.
+ */
+struct rank_select {
+  private:
+    using _Word_t = __detail::__bitset::_Word_t;
+
+    const _Word_t * bits;   // Words of the bitset
+    size_t          length; // Number of bits
+    size_t          ones;   // Number of 1 bits
+
+    std::vector <_Word_t>   upper;  // 1 bits before each upper block
+    std::vector <_Word_t>   entry;  // One entry per super block, plus a sentinel
+    std::vector <uint32_t>  hints;  // Super block of every __Hint-th 1 bit
+
+  public:
+    rank_select() : bits(), length(), ones() {}
+
+    /* Build the index over __n bits starting at __src. */
+    rank_select(const _Word_t *__src, size_t __n) : bits(__src), length(__n) {
+        using namespace __detail::__rank;
+        const auto __words = __detail::__bitset::div_ceil(__n);
+        const auto __super = (__words + __SWords - 1) / __SWords;
+
+        entry.reserve(__super + 1);
+        size_t __total = 0;
+        for (size_t i = 0 ; i <= __super ; ++i) {
+            if (i % __USuper == 0) upper.push_back(__total);
+            size_t __cnt[4] = {};
+            for (size_t j = 0 ; j != 4 ; ++j) {
+                const auto __beg = std::min(__words, i * __SWords + j * __BWords);
+                const auto __end = std::min(__words, __beg + __BWords);
+                __cnt[j] = __detail::__bitset::do_count(__src + __beg, __end - __beg);
+            }
+            entry.push_back(make_entry(__total - upper.back(), __cnt));
+
+            /* Record hints for every __Hint-th 1 bit inside. */
+            const auto __next = __total + __cnt[0] + __cnt[1] + __cnt[2] + __cnt[3];
+            for (auto __k = (__total + __Hint - 1) / __Hint * __Hint ; __k < __next ; __k += __Hint)
+                hints.push_back(i);
+            __total = __next;
+        }
+        ones = __total;
+        hints.push_back(__super); // Sentinel.
+    }
+
+    explicit rank_select(const dynamic_bitset &__bits)
+        : rank_select(__bits.word_data(), __bits.size()) {}
+
+    /* Borrowed view of the index. */
+    __detail::__rank::rank_view view() const {
+        return { bits, length, ones, upper.data(), entry.data(), hints.data() };
+    }
+
+    /* Number of bits. */
+    size_t size()  const { return length; }
+    /* Number of 1 bits. */
+    size_t count() const { return ones; }
+
+    /* Number of 1 bits in [0, __n). __n is clamped to size(). */
+    size_t rank(size_t __n) const { return this->view().rank(__n); }
+
+    /* Number of 0 bits in [0, __n), __n <= size(). */
+    size_t rank0(size_t __n) const { return __n - this->rank(__n); }
+
+    /* Position of the __k-th (0-indexed) 1 bit, or -1 if __k >= count(). */
+    size_t select(size_t __k) const { return this->view().select(__k); }
+
+    /* Raw arrays, for serialization. */
+    const std::vector <_Word_t>  &upper_data() const { return upper; }
+    const std::vector <_Word_t>  &entry_data() const { return entry; }
+    const std::vector <uint32_t> &hints_data() const { return hints; }
+};
+
+
+} // namespace dark
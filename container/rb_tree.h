@@ -0,0 +1,780 @@
+#pragma once
+#include "frozen_tree.h"
+#include "allocator.h"
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <new>
+#include <vector>
+
+namespace dark {
+
+
+namespace __detail::__tree {
+
+template <typename _Tp, bool _Const>
+struct tree_iterator {
+  public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type        = _Tp;
+    using difference_type   = ptrdiff_t;
+    using pointer           = std::conditional_t <_Const, const _Tp, _Tp> *;
+    using reference         = std::conditional_t <_Const, const _Tp, _Tp> &;
+
+    node *ptr {}; // Current node, header for end().
+
+    constexpr tree_iterator() = default;
+    constexpr explicit tree_iterator(node *__ptr) : ptr(__ptr) {}
+    constexpr operator tree_iterator <_Tp, true> () const requires (!_Const) {
+        return tree_iterator <_Tp, true> {ptr};
+    }
+
+    constexpr reference operator *() const { return static_cast <value_node <_Tp> *> (ptr)->value; }
+    constexpr pointer  operator ->() const { return &**this; }
+
+    constexpr tree_iterator &operator ++() { ptr = advance <RT> (ptr); return *this; }
+    constexpr tree_iterator &operator --() {
+        /* Header keeps the rightmost node in child[RT]. */
+        ptr = ptr->is_header() ? ptr->child[RT] : advance <LT> (ptr);
+        return *this;
+    }
+    constexpr tree_iterator operator ++(int) { auto __tmp = *this; ++*this; return __tmp; }
+    constexpr tree_iterator operator --(int) { auto __tmp = *this; --*this; return __tmp; }
+
+    friend constexpr bool operator == (tree_iterator, tree_iterator) = default;
+};
+
+/* Value node which also keeps the _Monoid aggregate of its subtree. */
+template <typename _Tp, typename _Monoid>
+struct monoid_node : value_node <_Tp> {
+    typename _Monoid::value_type agg; // Aggregate of the subtree.
+};
+
+/* Augmentation hook (see size_only) for a tree of monoid_node. */
+template <typename _Tp, typename _Monoid>
+struct monoid_aug {
+    using _Node_t = monoid_node <_Tp, _Monoid>;
+    using _Agg_t  = typename _Monoid::value_type;
+
+    static _Agg_t agg(const node *__x) {
+        return __x == nullptr ? _Monoid::identity() : static_cast <const _Node_t *> (__x)->agg;
+    }
+    static _Agg_t lift(const node *__x) {
+        return _Monoid::lift(static_cast <const _Node_t *> (__x)->value);
+    }
+    static void pull(node *__x) {
+        static_cast <_Node_t *> (__x)->agg = _Monoid::combine(
+            _Monoid::combine(agg(__x->child[LT]), lift(__x)), agg(__x->child[RT]));
+    }
+    static void clear(node *__x) {
+        static_cast <_Node_t *> (__x)->agg = _Monoid::identity();
+    }
+};
+
+/**
+ * Red-black tree of unique keys, with subtree sizes for rank and select.
+ * Elements live in value_node; the header is a plain node inside the
+ * tree, with root in parent, leftmost in child[LT] and rightmost in
+ * child[RT]. An empty tree has a null root and both extremes at header.
+ *
+ * With a _Monoid (value_type, identity(), lift(element) and an associative
+ * combine(a, b)), each node also keeps the aggregate of its subtree, for
+ * O(log n) range folds and searches. void keeps nodes and code as they are.
+ * Elements are then immutable in place, as the aggregates depend on them.
+ */
+template <typename _Tp, typename _Key, typename _KeyOf, typename _Compare, bool _Mutable,
+          typename _Alloc, typename _Monoid = void>
+struct rb_tree {
+  protected:
+    static constexpr bool __Augmented = !std::is_void_v <_Monoid>;
+
+    using _Node_t   = std::conditional_t <__Augmented, monoid_node <_Tp, _Monoid>, value_node <_Tp>>;
+    using _Aug_t    = std::conditional_t <__Augmented, monoid_aug <_Tp, _Monoid>, size_only>;
+    using _Alloc_t  = typename _Alloc::template rebind <_Node_t>::other;
+
+  public:
+    using key_type          = _Key;
+    using value_type        = _Tp;
+    using size_type         = size_t;
+    using difference_type   = ptrdiff_t;
+    using key_compare       = _Compare;
+    using reference         = _Tp &;
+    using const_reference   = const _Tp &;
+    using const_iterator    = tree_iterator <_Tp, true>;
+    using iterator          = tree_iterator <_Tp, !_Mutable || __Augmented>;
+    using reverse_iterator       = std::reverse_iterator <iterator>;
+    using const_reverse_iterator = std::reverse_iterator <const_iterator>;
+
+  protected:
+    node header;
+    [[no_unique_address]] _Compare comp;
+    [[no_unique_address]] _Alloc_t alloc;
+
+    node *root() const { return header.parent; }
+    node *head() const { return const_cast <node *> (&header); }
+
+    static const _Key &key(const node *__node) {
+        return _KeyOf {} (static_cast <const _Node_t *> (__node)->value);
+    }
+
+    void reset() {
+        header.color  = WHITE;
+        header.size   = 0;
+        header.parent = nullptr;
+        header.child[LT] = header.child[RT] = &header;
+    }
+
+    template <typename... _Args>
+    _Node_t *make_node(_Args &&...__args) {
+        auto *__ptr = alloc.allocate(1);
+        try {
+            if constexpr (__Augmented)
+                ::new (static_cast <void *> (__ptr)) _Node_t {{{}, _Tp(std::forward <_Args> (__args)...)}, {}};
+            else
+                ::new (static_cast <void *> (__ptr)) _Node_t {{}, _Tp(std::forward <_Args> (__args)...)};
+        } catch (...) {
+            alloc.deallocate(__ptr, 1);
+            throw;
+        }
+        return __ptr;
+    }
+
+    void drop_node(node *__node) {
+        auto *__ptr = static_cast <_Node_t *> (__node);
+        __ptr->~_Node_t();
+        alloc.deallocate(__ptr, 1);
+    }
+
+    /* Free a subtree. Depth is O(log n), so recursion is fine. */
+    void drop_tree(node *__node) {
+        while (__node != nullptr) {
+            drop_tree(__node->child[RT]);
+            auto *__left = __node->child[LT];
+            drop_node(__node);
+            __node = __left;
+        }
+    }
+
+    /* Deep copy of a subtree, colors, sizes and aggregates included. */
+    node *copy_tree(const node *__src, node *__parent) {
+        if (__src == nullptr) return nullptr;
+        node *__dst = make_node(static_cast <const _Node_t *> (__src)->value);
+        __dst->color  = __src->color;
+        __dst->size   = __src->size;
+        __dst->parent = __parent;
+        __dst->child[LT] = __dst->child[RT] = nullptr;
+        try {
+            __dst->child[LT] = copy_tree(__src->child[LT], __dst);
+            __dst->child[RT] = copy_tree(__src->child[RT], __dst);
+        } catch (...) {
+            drop_tree(__dst);
+            throw;
+        }
+        _Aug_t::pull(__dst);
+        return __dst;
+    }
+
+    /* Take over the nodes of __rhs, which must be empty afterwards. */
+    void steal(rb_tree &__rhs) {
+        if (__rhs.root() == nullptr) return this->reset();
+        header.parent = __rhs.header.parent;
+        header.child[LT] = __rhs.header.child[LT];
+        header.child[RT] = __rhs.header.child[RT];
+        header.parent->parent = &header;
+        __rhs.reset();
+    }
+
+    /**
+     * First node not less than __key (lower bound). If it is equal,
+     * set __equal. Otherwise, (__parent, __dir) is where to link __key.
+     * One comparison per level, plus one at the end.
+     */
+    struct slot { node *parent; Direction dir; node *equal; };
+    slot locate(const _Key &__key) const { return this->locate(__key, this->root()); }
+
+    /* As above, but descend from __top, whose subtree must hold the slot. */
+    slot locate(const _Key &__key, node *__top) const {
+        node *__parent  = this->head();
+        node *__lower   = nullptr;
+        Direction __dir = LT;
+        search_probe __probe;
+        for (auto *__cur = __top ; __cur != nullptr ; __cur = __cur->child[__dir]) {
+            __probe.step();
+            __parent = __cur;
+            __dir = static_cast <Direction> (comp(key(__cur), __key));
+            if (__dir == LT) __lower = __cur;
+        }
+        if (__lower != nullptr && !comp(__key, key(__lower)))
+            return { __parent, __dir, __lower };
+        return { __parent, __dir, nullptr };
+    }
+
+    /**
+     * Slot for __key, searched from __hint (header for end()): a finger
+     * search. If __key goes right next to __hint, the cost is O(1).
+     * Otherwise climb from the neighbor only until the subtree must hold
+     * __key, then descend: O(log d) for d elements in between.
+     */
+    slot locate_near(const _Key &__key, node *__hint) const {
+        if (this->empty()) return { this->head(), LT, nullptr };
+
+        Direction __d = LT; // Side of __hint where __key goes.
+        if (__hint != this->head()) {
+            if (comp(key(__hint), __key)) __d = RT;
+            else if (!comp(__key, key(__hint))) return { __hint, LT, __hint };
+        }
+
+        /* Whether __x is on the near (__hint's) side of __key, or past it. */
+        const auto __near = [&](const node *__x) {
+            return __d == LT ? comp(key(__x), __key) : comp(__key, key(__x));
+        };
+        const auto __past = [&](const node *__x) {
+            return __d == LT ? comp(__key, key(__x)) : comp(key(__x), __key);
+        };
+
+        /* Neighbor of __hint on that side, header if none. */
+        node *__next = __hint == this->head() ? header.child[RT]
+                     : __d == LT ? advance <LT> (__hint) : advance <RT> (__hint);
+        if (__next == this->head() || __near(__next)) {
+            /* Right between: one of the two has a free child there. */
+            if (__hint == this->head())         return { __next, RT, nullptr };
+            if (__hint->child[__d] == nullptr)  return { __hint, __d, nullptr };
+            return { __next, !__d, nullptr };
+        }
+        if (!__past(__next)) return { __next, LT, __next };
+
+        /* Climb until a parent on the near side of __x is near of __key too. */
+        node *__x = __next;
+        while (!__x->is_special()) {
+            node *__p = __x->parent;
+            if (__p->child[!__d] == __x && __near(__p)) break;
+            __x = __p;
+        }
+        return this->locate(__key, __x);
+    }
+
+    /* First node with !comp(key, __key) (lower) or comp(__key, key) (upper). */
+    template <bool _Upper>
+    node *bound(const _Key &__key) const {
+        node *__ret = this->head();
+        search_probe __probe;
+        for (auto *__cur = this->root() ; __cur != nullptr ;) {
+            __probe.step();
+            const bool __go_left = _Upper ? comp(__key, key(__cur)) : !comp(key(__cur), __key);
+            if (__go_left) {
+                __ret = __cur;
+                __cur = __cur->child[LT];
+            } else {
+                __cur = __cur->child[RT];
+            }
+        }
+        return __ret;
+    }
+
+    /* Node equal to __key, or nullptr. */
+    node *find_node(const _Key &__key) const {
+        auto *__ret = this->bound <false> (__key);
+        if (__ret == this->head() || comp(__key, key(__ret))) return nullptr;
+        return __ret;
+    }
+
+    /* Construct first: the key is only known from the value. */
+    template <typename... _Args>
+    std::pair <iterator, bool> emplace_unique(_Args &&...__args) {
+        auto *__node = make_node(std::forward <_Args> (__args)...);
+        const auto [__parent, __dir, __equal] = this->locate(key(__node));
+        if (__equal != nullptr) {
+            drop_node(__node);
+            return { iterator {__equal}, false };
+        }
+        insert_at <_Aug_t> (this->head(), __parent, __dir, __node);
+        return { iterator {__node}, true };
+    }
+
+    /* Look up first: no allocation for a duplicate. */
+    template <typename _Up>
+    std::pair <iterator, bool> insert_unique(_Up &&__val) {
+        const auto [__parent, __dir, __equal] = this->locate(_KeyOf {} (__val));
+        if (__equal != nullptr) return { iterator {__equal}, false };
+        auto *__node = make_node(std::forward <_Up> (__val));
+        insert_at <_Aug_t> (this->head(), __parent, __dir, __node);
+        return { iterator {__node}, true };
+    }
+
+    /* As insert_unique, but searched from __hint. */
+    template <typename _Up>
+    iterator insert_near(node *__hint, _Up &&__val) {
+        const auto [__parent, __dir, __equal] = this->locate_near(_KeyOf {} (__val), __hint);
+        if (__equal != nullptr) return iterator {__equal};
+        auto *__node = make_node(std::forward <_Up> (__val));
+        insert_at <_Aug_t> (this->head(), __parent, __dir, __node);
+        return iterator {__node};
+    }
+
+    /* Nodes may only move between trees whose allocators can free each other's. */
+    static constexpr bool __Movable = std::allocator_traits <_Alloc_t>::is_always_equal::value;
+
+    /* Black height of this tree. */
+    size_t black_height() const { return __detail::__tree::black_height(this->root()); }
+
+  public:
+    rb_tree() { this->reset(); }
+    explicit rb_tree(const _Compare &__comp) : comp(__comp) { this->reset(); }
+
+    rb_tree(const rb_tree &__rhs) : comp(__rhs.comp), alloc(__rhs.alloc) {
+        this->reset();
+        if (__rhs.root() == nullptr) return;
+        header.parent = copy_tree(__rhs.root(), &header);
+        header.child[LT] = get_most <LT> (header.parent);
+        header.child[RT] = get_most <RT> (header.parent);
+    }
+    rb_tree(rb_tree &&__rhs) noexcept
+        : comp(std::move(__rhs.comp)), alloc(std::move(__rhs.alloc)) { this->steal(__rhs); }
+
+    rb_tree &operator = (const rb_tree &__rhs) {
+        if (this != &__rhs) { rb_tree __tmp(__rhs); this->swap(__tmp); }
+        return *this;
+    }
+    rb_tree &operator = (rb_tree &&__rhs) noexcept {
+        if (this != &__rhs) {
+            this->clear();
+            comp  = std::move(__rhs.comp);
+            alloc = std::move(__rhs.alloc);
+            this->steal(__rhs);
+        }
+        return *this;
+    }
+
+    ~rb_tree() { drop_tree(this->root()); }
+
+    void swap(rb_tree &__rhs) noexcept {
+        rb_tree __tmp(std::move(__rhs));
+        __rhs = std::move(*this);
+        *this = std::move(__tmp);
+    }
+
+    void clear() { drop_tree(this->root()); this->reset(); }
+
+    size_t size()  const { return size_of(this->root()); }
+    bool   empty() const { return this->root() == nullptr; }
+
+    iterator begin() { return iterator {header.child[LT]}; }
+    iterator end()   { return iterator {this->head()}; }
+    const_iterator begin() const { return const_iterator {header.child[LT]}; }
+    const_iterator end()   const { return const_iterator {this->head()}; }
+    const_iterator cbegin() const { return this->begin(); }
+    const_iterator cend()   const { return this->end(); }
+
+    reverse_iterator rbegin() { return reverse_iterator {this->end()}; }
+    reverse_iterator rend()   { return reverse_iterator {this->begin()}; }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator {this->end()}; }
+    const_reverse_iterator rend()   const { return const_reverse_iterator {this->begin()}; }
+
+    key_compare key_comp() const { return comp; }
+
+  public:
+    /* Section of lookups. */
+
+    iterator find(const _Key &__key) {
+        auto *__ret = this->find_node(__key);
+        return __ret == nullptr ? this->end() : iterator {__ret};
+    }
+    const_iterator find(const _Key &__key) const {
+        auto *__ret = this->find_node(__key);
+        return __ret == nullptr ? this->end() : const_iterator {__ret};
+    }
+
+    bool   contains(const _Key &__key) const { return this->find_node(__key) != nullptr; }
+    size_t count(const _Key &__key) const { return this->contains(__key); }
+
+    iterator lower_bound(const _Key &__key) { return iterator {this->bound <false> (__key)}; }
+    iterator upper_bound(const _Key &__key) { return iterator {this->bound <true>  (__key)}; }
+    const_iterator lower_bound(const _Key &__key) const { return const_iterator {this->bound <false> (__key)}; }
+    const_iterator upper_bound(const _Key &__key) const { return const_iterator {this->bound <true>  (__key)}; }
+
+    /* Number of elements less than __key. */
+    size_t rank(const _Key &__key) const {
+        size_t __ret = 0;
+        for (auto *__cur = this->root() ; __cur != nullptr ;) {
+            if (comp(key(__cur), __key)) {
+                __ret += size_of(__cur->child[LT]) + 1;
+                __cur  = __cur->child[RT];
+            } else {
+                __cur  = __cur->child[LT];
+            }
+        }
+        return __ret;
+    }
+
+    /* Number of elements before __pos. rank(end()) == size(). */
+    size_t rank(const_iterator __pos) const {
+        return __pos.ptr == this->head() ? this->size() : index_of(__pos.ptr);
+    }
+
+    /* The __k-th (0-indexed) smallest element, or end() if __k >= size(). */
+    iterator select(size_t __k) {
+        if (__k >= this->size()) return this->end();
+        return iterator {__detail::__tree::select(this->root(), __k)};
+    }
+    const_iterator select(size_t __k) const {
+        return const_cast <rb_tree *> (this)->select(__k);
+    }
+
+  public:
+    /* Section of aggregates, for a tree with a _Monoid. */
+
+    /* Aggregate of all elements. O(1). */
+    auto aggregate() const requires __Augmented { return _Aug_t::agg(this->root()); }
+
+    /**
+     * Aggregate of the elements with keys in [__lo, __hi), in order.
+     * Descend to the first node inside the range, then fold the part
+     * not less than __lo of its left subtree and the part less than
+     * __hi of its right one, one whole subtree per level. O(log n).
+     */
+    auto aggregate(const _Key &__lo, const _Key &__hi) const requires __Augmented {
+        auto *__cur = this->root();
+        while (__cur != nullptr) {
+            if (comp(key(__cur), __lo))         __cur = __cur->child[RT];
+            else if (!comp(key(__cur), __hi))   __cur = __cur->child[LT];
+            else break;
+        }
+        if (__cur == nullptr) return _Monoid::identity();
+
+        auto __suffix = _Aug_t::lift(__cur); // Fold of the left side, then __cur.
+        for (auto *__x = __cur->child[LT] ; __x != nullptr ;) {
+            if (comp(key(__x), __lo)) { __x = __x->child[RT]; continue; }
+            __suffix = _Monoid::combine(_Monoid::combine(_Aug_t::lift(__x),
+                _Aug_t::agg(__x->child[RT])), __suffix);
+            __x = __x->child[LT];
+        }
+        auto __ret = __suffix;
+        for (auto *__x = __cur->child[RT] ; __x != nullptr ;) {
+            if (!comp(key(__x), __hi)) { __x = __x->child[LT]; continue; }
+            __ret = _Monoid::combine(__ret, _Monoid::combine(
+                _Aug_t::agg(__x->child[LT]), _Aug_t::lift(__x)));
+            __x = __x->child[RT];
+        }
+        return __ret;
+    }
+
+    /**
+     * First element whose prefix aggregate (itself included) satisfies
+     * __pred, or end(). __pred must be false, then true, along prefixes,
+     * e.g. "sum >= k", or "max end >= lo" for interval overlap. O(log n).
+     */
+    template <typename _Pred>
+    const_iterator find_first(_Pred &&__pred) const requires __Augmented {
+        auto __acc = _Monoid::identity();
+        for (auto *__cur = this->root() ; __cur != nullptr ;) {
+            auto __left = _Monoid::combine(__acc, _Aug_t::agg(__cur->child[LT]));
+            if (__pred(std::as_const(__left))) { __cur = __cur->child[LT]; continue; }
+            __acc = _Monoid::combine(std::move(__left), _Aug_t::lift(__cur));
+            if (__pred(std::as_const(__acc))) return const_iterator {__cur};
+            __cur = __cur->child[RT];
+        }
+        return this->end();
+    }
+
+  public:
+    /* Section of modifiers. */
+
+    std::pair <iterator, bool> insert(const _Tp &__val) { return this->insert_unique(__val); }
+    std::pair <iterator, bool> insert(_Tp &&__val) { return this->insert_unique(std::move(__val)); }
+
+    template <typename _Iter>
+    void insert(_Iter __first, _Iter __last) {
+        for (; __first != __last ; ++__first) this->insert_unique(*__first);
+    }
+
+    /**
+     * Insert __val, searching from __hint: O(1) compares if it goes right
+     * before or after __hint, as with end() for increasing keys, and
+     * O(log d) if d elements away. Return the element with that key.
+     */
+    iterator insert(const_iterator __hint, const _Tp &__val) { return this->insert_near(__hint.ptr, __val); }
+    iterator insert(const_iterator __hint, _Tp &&__val) { return this->insert_near(__hint.ptr, std::move(__val)); }
+
+    /**
+     * Insert [__first, __last), keeping the first of equal keys. The batch
+     * is sorted, then merged in order: each element is searched from the
+     * one before, or, if the batch is large next to the tree, all nodes
+     * are merged and relinked in O(n + m) with no rotation.
+     */
+    template <typename _Iter>
+    void insert_batch(_Iter __first, _Iter __last) {
+        const auto __less = [this](const node *__a, const node *__b) { return comp(key(__a), key(__b)); };
+        std::vector <node *> __nodes;
+        try {
+            for (; __first != __last ; ++__first) __nodes.push_back(make_node(*__first));
+            std::stable_sort(__nodes.begin(), __nodes.end(), __less);
+        } catch (...) {
+            for (auto *__node : __nodes) drop_node(__node);
+            throw;
+        }
+
+        size_t __m = 0;
+        for (auto *__node : __nodes) {
+            if (__m == 0 || __less(__nodes[__m - 1], __node)) __nodes[__m++] = __node;
+            else drop_node(__node);
+        }
+        __nodes.resize(__m);
+
+        const auto __n = this->size();
+        if (__m * std::bit_width(__n) < __n) {
+            node *__prev = nullptr;
+            for (auto *__node : __nodes) {
+                const auto [__parent, __dir, __equal] = __prev == nullptr
+                    ? this->locate(key(__node)) : this->locate_near(key(__node), __prev);
+                if (__equal != nullptr) {
+                    drop_node(__node);
+                    __prev = __equal;
+                } else {
+                    insert_at <_Aug_t> (this->head(), __parent, __dir, __node);
+                    __prev = __node;
+                }
+            }
+            return;
+        }
+
+        std::vector <node *> __all;
+        try {
+            __all.reserve(__n + __m);
+        } catch (...) {
+            for (auto *__node : __nodes) drop_node(__node);
+            throw;
+        }
+        node *__old = header.child[LT];
+        for (auto *__node : __nodes) {
+            for (; __old != this->head() && __less(__old, __node) ; __old = advance <RT> (__old))
+                __all.push_back(__old);
+            if (__old != this->head() && !__less(__node, __old)) drop_node(__node);
+            else __all.push_back(__node);
+        }
+        for (; __old != this->head() ; __old = advance <RT> (__old))
+            __all.push_back(__old);
+        this->reset();
+        build <_Aug_t> (this->head(), __all.data(), __all.size());
+    }
+
+    template <typename... _Args>
+    std::pair <iterator, bool> emplace(_Args &&...__args) {
+        return this->emplace_unique(std::forward <_Args> (__args)...);
+    }
+
+    /* Erase the element at __pos, return the next one. */
+    iterator erase(const_iterator __pos) {
+        auto *__node = __pos.ptr;
+        auto *__next = advance <RT> (__node);
+        erase_at <_Aug_t> (this->head(), __node);
+        drop_node(__node);
+        return iterator {__next};
+    }
+
+    size_t erase(const _Key &__key) {
+        auto *__node = this->find_node(__key);
+        if (__node == nullptr) return 0;
+        erase_at <_Aug_t> (this->head(), __node);
+        drop_node(__node);
+        return 1;
+    }
+
+  public:
+    /* Section of bulk operations. */
+
+    /**
+     * Replace the contents with [__first, __last), whose keys must be
+     * strictly increasing. Nodes are linked in O(n), with no compare
+     * beyond the order check and no rotation.
+     */
+    template <typename _Iter>
+    void assign_sorted(_Iter __first, _Iter __last) {
+        std::vector <node *> __nodes;
+        if constexpr (std::forward_iterator <_Iter>)
+            __nodes.reserve(std::distance(__first, __last));
+        try {
+            for (; __first != __last ; ++__first) {
+                auto *__node = make_node(*__first);
+                __nodes.push_back(__node);
+                if (__nodes.size() > 1 && !comp(key(__nodes.end()[-2]), key(__node)))
+                    throw std::invalid_argument("rb_tree::assign_sorted: Keys out of order.");
+            }
+        } catch (...) {
+            for (auto *__node : __nodes) drop_node(__node);
+            throw;
+        }
+        this->clear();
+        build <_Aug_t> (this->head(), __nodes.data(), __nodes.size());
+    }
+
+    /**
+     * Move the elements not less than __key into __rhs, which is cleared
+     * first. O(log n). Nodes are relinked, not copied, so the allocators
+     * must be interchangeable.
+     */
+    void split(const _Key &__key, rb_tree &__rhs) requires __Movable {
+        __rhs.clear();
+        __detail::__tree::split <_Aug_t> (this->head(), __rhs.head(),
+            [&](const node *__node) { return !comp(key(__node), __key); });
+    }
+
+    /**
+     * Append __mid and then all of __rhs, which is left empty.
+     * Keys must be in order: this < __mid < __rhs. O(log n).
+     */
+    void join(_Tp __mid, rb_tree &__rhs) requires __Movable {
+        auto *__node = make_node(std::move(__mid));
+        if ((!this->empty() && !comp(key(header.child[RT]), key(__node)))
+        ||  (!__rhs.empty() && !comp(key(__node), key(__rhs.header.child[LT])))) {
+            drop_node(__node);
+            throw std::invalid_argument("rb_tree::join: Keys out of order.");
+        }
+        this->link(__node, __rhs);
+    }
+
+    /* Append all of __rhs, which is left empty. Keys must be in order. O(log n). */
+    void join(rb_tree &__rhs) requires __Movable {
+        if (__rhs.empty()) return;
+        if (!this->empty() && !comp(key(header.child[RT]), key(__rhs.header.child[LT])))
+            throw std::invalid_argument("rb_tree::join: Keys out of order.");
+        auto *__node = __rhs.header.child[LT];
+        erase_at <_Aug_t> (__rhs.head(), __node);
+        this->link(__node, __rhs);
+    }
+
+    /**
+     * Immutable snapshot in Eytzinger layout, for read-mostly lookups.
+     * O(n); later changes to this tree are not seen by the snapshot.
+     */
+    auto freeze() const {
+        return __detail::__frozen::frozen_tree <_Tp, _Key, _KeyOf, _Compare> (this->begin(), this->end(), comp);
+    }
+
+    /**
+     * Depth histogram and memory spread of the nodes, for telling deep
+     * trees from scattered ones. O(n log n). Work counters are global
+     * per thread: see tree_counters.
+     */
+    tree_shape shape() const { return shape_of(this->root(), sizeof(_Node_t)); }
+
+  private:
+    void link(node *__mid, rb_tree &__rhs) {
+        auto *__lo = this->empty() ? __mid : header.child[LT];
+        auto *__hi = __rhs.empty() ? __mid : __rhs.header.child[RT];
+        __detail::__tree::join <_Aug_t> (this->head(), this->black_height(),
+                               __mid, __rhs.head(), __rhs.black_height());
+        header.child[LT] = __lo;
+        header.child[RT] = __hi;
+        __rhs.reset();
+    }
+};
+
+} // namespace __detail::__tree
+
+
+/**
+ * Monoids for the _Monoid parameter of rb_set and rb_map: sum, min and
+ * max of _Get(element). For a map, _Get may pick the mapped value, e.g.
+ * decltype([](const auto &__e) { return __e.second; }).
+ */
+template <typename _Agg, typename _Get = std::identity>
+struct monoid_sum {
+    using value_type = _Agg;
+    static constexpr _Agg identity() { return _Agg(); }
+    template <typename _Tp>
+    static constexpr _Agg lift(const _Tp &__val) { return _Agg(_Get {} (__val)); }
+    static constexpr _Agg combine(const _Agg &__a, const _Agg &__b) { return __a + __b; }
+};
+
+template <typename _Agg, typename _Get = std::identity>
+struct monoid_min {
+    using value_type = _Agg;
+    static constexpr _Agg identity() { return std::numeric_limits <_Agg>::max(); }
+    template <typename _Tp>
+    static constexpr _Agg lift(const _Tp &__val) { return _Agg(_Get {} (__val)); }
+    static constexpr _Agg combine(const _Agg &__a, const _Agg &__b) { return std::min(__a, __b); }
+};
+
+template <typename _Agg, typename _Get = std::identity>
+struct monoid_max {
+    using value_type = _Agg;
+    static constexpr _Agg identity() { return std::numeric_limits <_Agg>::lowest(); }
+    template <typename _Tp>
+    static constexpr _Agg lift(const _Tp &__val) { return _Agg(_Get {} (__val)); }
+    static constexpr _Agg combine(const _Agg &__a, const _Agg &__b) { return std::max(__a, __b); }
+};
+
+/**
+ * Ordered set of unique keys, with O(log n) rank and select.
+ * Backed by a red-black tree of 32-byte nodes plus the value.
+ * _Alloc is rebound to the node type, e.g. pool_allocator.
+ * _Monoid (e.g. monoid_sum) adds subtree aggregates; see rb_tree.
+ */
+template <typename _Tp, typename _Compare = std::less <_Tp>, typename _Alloc = allocator <_Tp>,
+          typename _Monoid = void>
+struct rb_set : __detail::__tree::rb_tree <
+    _Tp, _Tp, __detail::__tree::key_self, _Compare, false, _Alloc, _Monoid> {
+    using __detail::__tree::rb_tree <
+        _Tp, _Tp, __detail::__tree::key_self, _Compare, false, _Alloc, _Monoid>::rb_tree;
+};
+
+/**
+ * Ordered map of unique keys, with O(log n) rank and select.
+ * Elements are std::pair <const _Key, _Val>, as in std::map.
+ * With a _Monoid, mapped values change only through update().
+ */
+template <typename _Key, typename _Val, typename _Compare = std::less <_Key>,
+          typename _Alloc = allocator <std::pair <const _Key, _Val>>, typename _Monoid = void>
+struct rb_map : __detail::__tree::rb_tree <
+    std::pair <const _Key, _Val>, _Key, __detail::__tree::key_first, _Compare, true, _Alloc, _Monoid> {
+  private:
+    using _Base_t = __detail::__tree::rb_tree <
+        std::pair <const _Key, _Val>, _Key, __detail::__tree::key_first, _Compare, true, _Alloc, _Monoid>;
+    using _Base_t::__Augmented;
+
+  public:
+    using mapped_type = _Val;
+    using typename _Base_t::iterator;
+    using _Base_t::_Base_t;
+
+    /* Insert (__key, _Val(__args...)) if __key is absent. */
+    template <typename... _Args>
+    std::pair <iterator, bool> try_emplace(const _Key &__key, _Args &&...__args) {
+        const auto [__parent, __dir, __equal] = this->locate(__key);
+        if (__equal != nullptr) return { iterator {__equal}, false };
+        auto *__node = this->make_node(std::piecewise_construct,
+            std::forward_as_tuple(__key), std::forward_as_tuple(std::forward <_Args> (__args)...));
+        __detail::__tree::insert_at <typename _Base_t::_Aug_t> (this->head(), __parent, __dir, __node);
+        return { iterator {__node}, true };
+    }
+
+    _Val &operator [] (const _Key &__key) requires (!__Augmented) {
+        return this->try_emplace(__key).first->second;
+    }
+
+    _Val &at(const _Key &__key) requires (!__Augmented) {
+        const auto __pos = this->find(__key);
+        if (__pos == this->end()) throw std::out_of_range("rb_map::at");
+        return __pos->second;
+    }
+    const _Val &at(const _Key &__key) const {
+        auto *__node = this->find_node(__key);
+        if (__node == nullptr) throw std::out_of_range("rb_map::at");
+        return static_cast <const typename _Base_t::_Node_t *> (__node)->value.second;
+    }
+
+    /* Call __fn on the mapped value at __pos, then refresh the aggregates above it. */
+    template <typename _Fn>
+    void update(typename _Base_t::const_iterator __pos, _Fn &&__fn) requires __Augmented {
+        auto *__node = __pos.ptr;
+        __fn(static_cast <typename _Base_t::_Node_t *> (__node)->value.second);
+        for (; __node != this->head() ; __node = __node->parent)
+            _Base_t::_Aug_t::pull(__node);
+    }
+};
+
+
+} // namespace dark
@@ -0,0 +1,617 @@
+#pragma once
+#include "bitset.h"
+#include <vector>
+#include <algorithm>
+
+namespace dark {
+
+
+struct roaring_bitmap;
+
+
+namespace __detail::__roaring {
+
+using __bitset::_Word_t;
+using __bitset::__WBits;
+
+/* Bits in one chunk. */
+inline constexpr size_t __CBits  = size_t{1} << 16;
+/* Words in one dense chunk. */
+inline constexpr size_t __CWords = __CBits / __WBits;
+/* Max cardinality of an array chunk. */
+inline constexpr size_t __AMax   = 4096;
+/* Bytes of a dense chunk. */
+inline constexpr size_t __BBytes = __CWords * sizeof(_Word_t);
+
+enum Kind : uint8_t { ARRAY = 0, BITMAP = 1, RUN = 2 };
+
+/* One 2^16-bit chunk of the universe. */
+struct chunk {
+    uint16_t    key  = 0;       // High 16 bits of values in this chunk
+    Kind        kind = ARRAY;   // Representation of the chunk
+    uint32_t    card = 0;       // Number of values in the chunk
+    std::vector <uint16_t> vals {}; // ARRAY: sorted values. RUN: [first, last] pairs.
+    std::vector <_Word_t>  bits {}; // BITMAP: __CWords words.
+
+    /* Number of runs, only for RUN. */
+    size_t runs() const { return vals.size() / 2; }
+};
+
+/* Set bits in [__lo, __hi] of a dense chunk. */
+inline void fill_bits(_Word_t *__dst, size_t __lo, size_t __hi) {
+    using namespace __bitset;
+    const auto [__ld, __lm] = div_mod(__lo);
+    const auto [__hd, __hm] = div_mod(__hi);
+    const auto __top = ~_Word_t{0} >> (__WBits - 1 - __hm);
+    if (__ld == __hd) {
+        __dst[__ld] |= mask_top(__lm) & __top;
+    } else {
+        __dst[__ld] |= mask_top(__lm);
+        word_reset(__dst + __ld + 1, 1, __hd - __ld - 1);
+        __dst[__hd] |= __top;
+    }
+}
+
+/* Expand a chunk into __CWords zeroed words. */
+inline void to_bits(const chunk &__c, _Word_t *__dst) {
+    using namespace __bitset;
+    switch (__c.kind) {
+        case ARRAY:
+            for (const auto __v : __c.vals)
+                __dst[__v / __WBits] |= mask_pos(__v % __WBits);
+            break;
+        case BITMAP:
+            word_copy(__dst, __c.bits.data(), __CWords);
+            break;
+        case RUN:
+            for (size_t i = 0 ; i != __c.vals.size() ; i += 2)
+                fill_bits(__dst, __c.vals[i], __c.vals[i + 1]);
+            break;
+    }
+}
+
+/* Return a dense copy of the chunk. */
+inline std::vector <_Word_t> dense(const chunk &__c) {
+    std::vector <_Word_t> __bits(__CWords);
+    to_bits(__c, __bits.data());
+    return __bits;
+}
+
+/* Count runs of 1 in a dense chunk. */
+inline size_t count_runs(const _Word_t *__src) {
+    size_t  __cnt = 0;
+    _Word_t __pre = 0; // Top bit of previous word.
+    for (size_t i = 0 ; i != __CWords ; ++i) {
+        const auto __cur = __src[i];
+        __cnt += std::popcount(__cur & ~(__cur << 1 | __pre));
+        __pre  = __cur >> (__WBits - 1);
+    }
+    return __cnt;
+}
+
+/* Rebuild __c from a dense chunk, picking the smallest representation. */
+inline void from_bits(chunk &__c, std::vector <_Word_t> &&__bits) {
+    using namespace __bitset;
+    const auto __src  = __bits.data();
+    const auto __card = do_count(__src, __CWords);
+    const auto __runs = count_runs(__src);
+
+    const auto __asize = __card <= __AMax ? __card * sizeof(uint16_t) : size_t(-1);
+    const auto __rsize = __runs * 2 * sizeof(uint16_t);
+
+    __c.card = __card;
+    __c.vals.clear();
+    __c.bits.clear();
+
+    if (__rsize < __asize && __rsize < __BBytes) {
+        __c.kind = RUN;
+        __c.vals.resize(__runs * 2);
+        size_t  __beg = 0, __end = 1;
+        _Word_t __pre = 0, __nxt;
+        for (size_t i = 0 ; i != __CWords ; ++i, __pre = __nxt) {
+            const auto __cur = __src[i];
+            const auto __low = i + 1 != __CWords ? __src[i + 1] & 1 : 0;
+            __nxt = __cur >> (__WBits - 1);
+            auto __head = __cur & ~(__cur << 1 | __pre);
+            auto __tail = __cur & ~(__cur >> 1 | __low << (__WBits - 1));
+            const auto __base = i * __WBits;
+            for (; __head ; __head &= __head - 1, __beg += 2)
+                __c.vals[__beg] = __base + std::countr_zero(__head);
+            for (; __tail ; __tail &= __tail - 1, __end += 2)
+                __c.vals[__end] = __base + std::countr_zero(__tail);
+        }
+    } else if (__asize <= __BBytes) {
+        __c.kind = ARRAY;
+        __c.vals.reserve(__card);
+        for (const auto __v : one_range {__src, __CWords})
+            __c.vals.push_back(__v);
+    } else {
+        __c.kind = BITMAP;
+        __c.bits = std::move(__bits);
+    }
+}
+
+/* Normalize a chunk whose run list has just been rebuilt. */
+inline void from_runs(chunk &__c) {
+    size_t __card = 0;
+    for (size_t i = 0 ; i != __c.vals.size() ; i += 2)
+        __card += __c.vals[i + 1] - __c.vals[i] + 1;
+    __c.kind = RUN;
+    __c.card = __card;
+    const auto __rsize = __c.vals.size() * sizeof(uint16_t);
+    const auto __asize = __card <= __AMax ? __card * sizeof(uint16_t) : size_t(-1);
+    if (__rsize > __asize || __rsize > __BBytes)
+        from_bits(__c, dense(__c));
+}
+
+/* Normalize a chunk whose array has just been rebuilt. */
+inline void from_array(chunk &__c) {
+    __c.kind = ARRAY;
+    __c.card = __c.vals.size();
+    if (__c.card > __AMax) from_bits(__c, dense(__c));
+}
+
+/* Index of the last run starting at or before __v, or -1 if none. */
+inline size_t find_run(const chunk &__c, uint16_t __v) {
+    size_t __lo = 0, __hi = __c.runs();
+    while (__lo != __hi) {
+        const auto __mid = (__lo + __hi) / 2;
+        if (__c.vals[__mid * 2] <= __v) __lo = __mid + 1;
+        else                            __hi = __mid;
+    }
+    return __lo - 1;
+}
+
+inline bool contains(const chunk &__c, uint16_t __v) {
+    switch (__c.kind) {
+        case ARRAY:
+            return std::binary_search(__c.vals.begin(), __c.vals.end(), __v);
+        case BITMAP:
+            return __c.bits[__v / __WBits] >> (__v % __WBits) & 1;
+        case RUN: {
+            const auto __i = find_run(__c, __v);
+            return __i != size_t(-1) && __v <= __c.vals[__i * 2 + 1];
+        }
+    }
+    unreachable();
+}
+
+/* Insert __v, return whether it was absent. */
+inline bool insert(chunk &__c, uint16_t __v) {
+    switch (__c.kind) {
+        case ARRAY: {
+            const auto __it = std::lower_bound(__c.vals.begin(), __c.vals.end(), __v);
+            if (__it != __c.vals.end() && *__it == __v) return false;
+            __c.vals.insert(__it, __v);
+            from_array(__c);
+            return true;
+        }
+        case BITMAP: {
+            auto &__word = __c.bits[__v / __WBits];
+            const auto __msk = __bitset::mask_pos(__v % __WBits);
+            if (__word & __msk) return false;
+            __word |= __msk;
+            ++__c.card;
+            return true;
+        }
+        case RUN: {
+            const auto __i = find_run(__c, __v) + 1; // First run after __v.
+            auto &__vals = __c.vals;
+            const bool __has_prev = __i != 0;
+            const bool __has_next = __i != __c.runs();
+            if (__has_prev && __v <= __vals[__i * 2 - 1]) return false;
+            const bool __join_prev = __has_prev && __vals[__i * 2 - 1] + 1 == __v;
+            const bool __join_next = __has_next && __vals[__i * 2] == __v + 1;
+            if (__join_prev && __join_next) {
+                __vals[__i * 2 - 1] = __vals[__i * 2 + 1];
+                __vals.erase(__vals.begin() + __i * 2, __vals.begin() + __i * 2 + 2);
+            } else if (__join_prev) {
+                __vals[__i * 2 - 1] = __v;
+            } else if (__join_next) {
+                __vals[__i * 2] = __v;
+            } else {
+                __vals.insert(__vals.begin() + __i * 2, {__v, __v});
+            }
+            ++__c.card;
+            if (__vals.size() * sizeof(uint16_t) > __BBytes)
+                from_bits(__c, dense(__c));
+            return true;
+        }
+    }
+    unreachable();
+}
+
+/* Erase __v, return whether it was present. */
+inline bool erase(chunk &__c, uint16_t __v) {
+    switch (__c.kind) {
+        case ARRAY: {
+            const auto __it = std::lower_bound(__c.vals.begin(), __c.vals.end(), __v);
+            if (__it == __c.vals.end() || *__it != __v) return false;
+            __c.vals.erase(__it);
+            --__c.card;
+            return true;
+        }
+        case BITMAP: {
+            auto &__word = __c.bits[__v / __WBits];
+            const auto __msk = __bitset::mask_pos(__v % __WBits);
+            if (!(__word & __msk)) return false;
+            __word &= ~__msk;
+            if (--__c.card <= __AMax) {
+                auto __bits = std::move(__c.bits);
+                from_bits(__c, std::move(__bits));
+            }
+            return true;
+        }
+        case RUN: {
+            const auto __i = find_run(__c, __v);
+            auto &__vals = __c.vals;
+            if (__i == size_t(-1) || __v > __vals[__i * 2 + 1]) return false;
+            const auto __first = __vals[__i * 2];
+            const auto __last  = __vals[__i * 2 + 1];
+            if (__first == __last) {
+                __vals.erase(__vals.begin() + __i * 2, __vals.begin() + __i * 2 + 2);
+            } else if (__v == __first) {
+                __vals[__i * 2] = __v + 1;
+            } else if (__v == __last) {
+                __vals[__i * 2 + 1] = __v - 1;
+            } else {
+                __vals[__i * 2 + 1] = __v - 1;
+                const uint16_t __next = __v + 1;
+                __vals.insert(__vals.begin() + __i * 2 + 2, {__next, __last});
+            }
+            --__c.card;
+            if (__vals.size() * sizeof(uint16_t) > __BBytes)
+                from_bits(__c, dense(__c));
+            return true;
+        }
+    }
+    unreachable();
+}
+
+/* Combine two chunks through dense words with __fn. */
+template <typename _Fn>
+inline chunk dense_op(const chunk &__lhs, const chunk &__rhs, _Fn __fn) {
+    chunk __ret {__lhs.key};
+    auto __bits = dense(__lhs);
+    if (__rhs.kind == BITMAP) {
+        __fn(__bits.data(), __rhs.bits.data(), __CBits);
+    } else {
+        const auto __temp = dense(__rhs);
+        __fn(__bits.data(), __temp.data(), __CBits);
+    }
+    from_bits(__ret, std::move(__bits));
+    return __ret;
+}
+
+/* Keep values of __arr for which contains(__rhs) == _Keep. */
+template <bool _Keep>
+inline chunk filter(const chunk &__arr, const chunk &__rhs) {
+    chunk __ret {__arr.key, ARRAY};
+    for (const auto __v : __arr.vals)
+        if (contains(__rhs, __v) == _Keep) __ret.vals.push_back(__v);
+    from_array(__ret);
+    return __ret;
+}
+
+inline chunk chunk_and(const chunk &__lhs, const chunk &__rhs) {
+    if (__lhs.kind == ARRAY) return filter <true> (__lhs, __rhs);
+    if (__rhs.kind == ARRAY) return filter <true> (__rhs, __lhs);
+    if (__lhs.kind == RUN && __rhs.kind == RUN) {
+        chunk __ret {__lhs.key, RUN};
+        const auto &__a = __lhs.vals;
+        const auto &__b = __rhs.vals;
+        for (size_t i = 0, j = 0 ; i != __a.size() && j != __b.size() ;) {
+            const auto __first = std::max(__a[i], __b[j]);
+            const auto __last  = std::min(__a[i + 1], __b[j + 1]);
+            if (__first <= __last) __ret.vals.insert(__ret.vals.end(), {__first, __last});
+            if (__a[i + 1] < __b[j + 1]) i += 2; else j += 2;
+        }
+        from_runs(__ret);
+        return __ret;
+    }
+    return dense_op(__lhs, __rhs, __bitset::do_and);
+}
+
+inline chunk chunk_or(const chunk &__lhs, const chunk &__rhs) {
+    if (__lhs.kind == ARRAY && __rhs.kind == ARRAY) {
+        chunk __ret {__lhs.key, ARRAY};
+        __ret.vals.reserve(__lhs.card + __rhs.card);
+        std::set_union(__lhs.vals.begin(), __lhs.vals.end(),
+                       __rhs.vals.begin(), __rhs.vals.end(),
+                       std::back_inserter(__ret.vals));
+        from_array(__ret);
+        return __ret;
+    }
+    if (__lhs.kind == RUN && __rhs.kind == RUN) {
+        chunk __ret {__lhs.key, RUN};
+        const auto &__a = __lhs.vals;
+        const auto &__b = __rhs.vals;
+        auto &__out = __ret.vals;
+        for (size_t i = 0, j = 0 ; i != __a.size() || j != __b.size() ;) {
+            const bool __take_a = j == __b.size() || (i != __a.size() && __a[i] <= __b[j]);
+            const auto *__run = __take_a ? &__a[i] : &__b[j];
+            (__take_a ? i : j) += 2;
+            /* Merge with the last run if overlapping or adjacent. */
+            if (!__out.empty() && __run[0] <= size_t(__out.back()) + 1)
+                __out.back() = std::max(__out.back(), __run[1]);
+            else
+                __out.insert(__out.end(), {__run[0], __run[1]});
+        }
+        from_runs(__ret);
+        return __ret;
+    }
+    return dense_op(__lhs, __rhs, __bitset::do_or_);
+}
+
+inline chunk chunk_xor(const chunk &__lhs, const chunk &__rhs) {
+    if (__lhs.kind == ARRAY && __rhs.kind == ARRAY) {
+        chunk __ret {__lhs.key, ARRAY};
+        std::set_symmetric_difference(
+            __lhs.vals.begin(), __lhs.vals.end(),
+            __rhs.vals.begin(), __rhs.vals.end(),
+            std::back_inserter(__ret.vals));
+        from_array(__ret);
+        return __ret;
+    }
+    return dense_op(__lhs, __rhs, __bitset::do_xor);
+}
+
+inline chunk chunk_andnot(const chunk &__lhs, const chunk &__rhs) {
+    if (__lhs.kind == ARRAY) return filter <false> (__lhs, __rhs);
+    return dense_op(__lhs, __rhs, [](_Word_t *__dst, const _Word_t *__src, size_t __n) {
+        for (size_t i = 0 ; i != __n / __WBits ; ++i) __dst[i] &= ~__src[i];
+    });
+}
+
+inline bool chunk_equal(const chunk &__lhs, const chunk &__rhs) {
+    if (__lhs.card != __rhs.card) return false;
+    if (__lhs.kind == __rhs.kind && __lhs.kind != BITMAP)
+        return __lhs.vals == __rhs.vals;
+    const auto __a = dense(__lhs);
+    const auto __b = dense(__rhs);
+    return __a == __b;
+}
+
+/* Call __fn on each value of the chunk, in increasing order. */
+template <typename _Fn>
+inline void for_each(const chunk &__c, _Fn &&__fn) {
+    const uint32_t __base = uint32_t(__c.key) << 16;
+    switch (__c.kind) {
+        case ARRAY:
+            for (const auto __v : __c.vals) __fn(__base | __v);
+            break;
+        case BITMAP:
+            for (const auto __v : __bitset::one_range {__c.bits.data(), __CWords})
+                __fn(__base | uint32_t(__v));
+            break;
+        case RUN:
+            for (size_t i = 0 ; i != __c.vals.size() ; i += 2)
+                for (uint32_t __v = __c.vals[i] ; __v <= __c.vals[i + 1] ; ++__v)
+                    __fn(__base | __v);
+            break;
+    }
+}
+
+/* Largest value in a non-empty chunk, low 16 bits only. */
+inline uint16_t chunk_max(const chunk &__c) {
+    switch (__c.kind) {
+        case ARRAY: return __c.vals.back();
+        case RUN:   return __c.vals.back();
+        case BITMAP:
+            return __bitset::find_prev(__c.bits.data(), __CBits, __CBits - 1);
+    }
+    unreachable();
+}
+
+} // namespace __detail::__roaring
+
+
+/**
+ * Compressed bitmap over 32-bit values.
+ * The universe is split into 2^16-bit chunks, each kept as
+ * a sorted array, a dense block or a run list, whichever is smaller.
+ */
+struct roaring_bitmap {
+  private:
+    using _Chunk_t = __detail::__roaring::chunk;
+    using _Word_t  = __detail::__bitset::_Word_t;
+
+    std::vector <_Chunk_t> chunks; // Non-empty chunks, sorted by key.
+
+    /* Return the chunk with given key, or the position to insert it. */
+    auto lower(uint16_t __key) {
+        return std::lower_bound(chunks.begin(), chunks.end(), __key,
+            [](const _Chunk_t &__c, uint16_t __k) { return __c.key < __k; });
+    }
+    auto lower(uint16_t __key) const {
+        return std::lower_bound(chunks.begin(), chunks.end(), __key,
+            [](const _Chunk_t &__c, uint16_t __k) { return __c.key < __k; });
+    }
+
+    /**
+     * Merge chunks of __lhs and __rhs by key.
+     * _Left / _Right: whether to keep chunks only present in that side.
+     */
+    template <bool _Left, bool _Right, typename _Fn>
+    static auto merge(const roaring_bitmap &__lhs, const roaring_bitmap &__rhs, _Fn __fn) {
+        std::vector <_Chunk_t> __out;
+        const auto &__a = __lhs.chunks;
+        const auto &__b = __rhs.chunks;
+        size_t i = 0, j = 0;
+        while (i != __a.size() && j != __b.size()) {
+            if (__a[i].key < __b[j].key) {
+                if constexpr (_Left)  __out.push_back(__a[i]);
+                ++i;
+            } else if (__b[j].key < __a[i].key) {
+                if constexpr (_Right) __out.push_back(__b[j]);
+                ++j;
+            } else {
+                auto __c = __fn(__a[i++], __b[j++]);
+                if (__c.card != 0) __out.push_back(std::move(__c));
+            }
+        }
+        if constexpr (_Left)  __out.insert(__out.end(), __a.begin() + i, __a.end());
+        if constexpr (_Right) __out.insert(__out.end(), __b.begin() + j, __b.end());
+        return __out;
+    }
+
+  public:
+    /* ctor and operator section. */
+
+    roaring_bitmap() = default;
+
+    /* Build from a dense bitset, which must hold at most 2^32 bits. */
+    explicit roaring_bitmap(const dynamic_bitset &__bits) {
+        using namespace __detail::__roaring;
+        if (__bits.size() > (size_t{1} << 32))
+            throw std::length_error("roaring_bitmap: bitset longer than 2^32");
+        const auto __data = __bits.word_data();
+        const auto __size = __bits.word_count();
+        for (size_t i = 0 ; i < __size ; i += __CWords) {
+            const auto __n = std::min(__CWords, __size - i);
+            if (__detail::__bitset::is_none(__data + i, __n)) continue;
+            std::vector <_Word_t> __temp(__CWords);
+            __detail::__bitset::word_copy(__temp.data(), __data + i, __n);
+            auto &__c = chunks.emplace_back();
+            __c.key = static_cast <uint16_t> (i / __CWords);
+            from_bits(__c, std::move(__temp));
+        }
+    }
+
+    roaring_bitmap &operator &= (const roaring_bitmap &__rhs) {
+        chunks = merge <false, false> (*this, __rhs, __detail::__roaring::chunk_and);
+        return *this;
+    }
+    roaring_bitmap &operator |= (const roaring_bitmap &__rhs) {
+        chunks = merge <true, true> (*this, __rhs, __detail::__roaring::chunk_or);
+        return *this;
+    }
+    roaring_bitmap &operator ^= (const roaring_bitmap &__rhs) {
+        chunks = merge <true, true> (*this, __rhs, __detail::__roaring::chunk_xor);
+        return *this;
+    }
+    /* Remove all values present in __rhs. */
+    roaring_bitmap &operator -= (const roaring_bitmap &__rhs) {
+        chunks = merge <true, false> (*this, __rhs, __detail::__roaring::chunk_andnot);
+        return *this;
+    }
+
+    friend roaring_bitmap operator & (roaring_bitmap __lhs, const roaring_bitmap &__rhs) { return __lhs &= __rhs; }
+    friend roaring_bitmap operator | (roaring_bitmap __lhs, const roaring_bitmap &__rhs) { return __lhs |= __rhs; }
+    friend roaring_bitmap operator ^ (roaring_bitmap __lhs, const roaring_bitmap &__rhs) { return __lhs ^= __rhs; }
+    friend roaring_bitmap operator - (roaring_bitmap __lhs, const roaring_bitmap &__rhs) { return __lhs -= __rhs; }
+
+    friend bool operator == (const roaring_bitmap &__lhs, const roaring_bitmap &__rhs) {
+        return std::equal(
+            __lhs.chunks.begin(), __lhs.chunks.end(),
+            __rhs.chunks.begin(), __rhs.chunks.end(),
+            [](const _Chunk_t &__a, const _Chunk_t &__b) {
+                return __a.key == __b.key && __detail::__roaring::chunk_equal(__a, __b);
+            });
+    }
+
+  public:
+    /* Function section. */
+
+    /* Insert __v, return whether it was absent. */
+    bool add(uint32_t __v) {
+        const auto __key = static_cast <uint16_t> (__v >> 16);
+        auto __it = this->lower(__key);
+        if (__it == chunks.end() || __it->key != __key)
+            __it = chunks.insert(__it, _Chunk_t {__key, __detail::__roaring::ARRAY, 0});
+        return __detail::__roaring::insert(*__it, static_cast <uint16_t> (__v));
+    }
+
+    /* Erase __v, return whether it was present. */
+    bool remove(uint32_t __v) {
+        const auto __key = static_cast <uint16_t> (__v >> 16);
+        auto __it = this->lower(__key);
+        if (__it == chunks.end() || __it->key != __key) return false;
+        if (!__detail::__roaring::erase(*__it, static_cast <uint16_t> (__v))) return false;
+        if (__it->card == 0) chunks.erase(__it);
+        return true;
+    }
+
+    /* Insert all values in [__lo, __hi). */
+    void add_range(uint64_t __lo, uint64_t __hi) {
+        using namespace __detail::__roaring;
+        if (__hi > (uint64_t{1} << 32)) __hi = uint64_t{1} << 32;
+        if (__lo >= __hi) return;
+        roaring_bitmap __range;
+        for (auto __key = __lo >> 16 ; __key <= (__hi - 1) >> 16 ; ++__key) {
+            const auto __base = __key << 16;
+            const uint16_t __first = std::max(__lo, __base) - __base;
+            const uint16_t __last  = std::min(__hi - 1, __base + __CBits - 1) - __base;
+            auto &__c = __range.chunks.emplace_back();
+            __c.key  = static_cast <uint16_t> (__key);
+            __c.vals = {__first, __last};
+            from_runs(__c);
+        }
+        *this |= __range;
+    }
+
+    bool contains(uint32_t __v) const {
+        const auto __key = static_cast <uint16_t> (__v >> 16);
+        auto __it = this->lower(__key);
+        return __it != chunks.end() && __it->key == __key
+            && __detail::__roaring::contains(*__it, static_cast <uint16_t> (__v));
+    }
+
+    /* Return the number of values. */
+    size_t size() const {
+        size_t __cnt = 0;
+        for (const auto &__c : chunks) __cnt += __c.card;
+        return __cnt;
+    }
+
+    bool empty() const { return chunks.empty(); }
+    void clear() { chunks.clear(); }
+
+    /* Return the largest value. The bitmap must not be empty. */
+    uint32_t max() const {
+        const auto &__c = chunks.back();
+        return uint32_t(__c.key) << 16 | __detail::__roaring::chunk_max(__c);
+    }
+
+    /* Call __fn on each value, in increasing order. */
+    template <typename _Fn>
+    void for_each(_Fn &&__fn) const {
+        for (const auto &__c : chunks) __detail::__roaring::for_each(__c, __fn);
+    }
+
+    /* Expand into a dense bitset of __n bits, values beyond are dropped. */
+    dynamic_bitset to_bitset(size_t __n) const {
+        using namespace __detail::__roaring;
+        dynamic_bitset __ret(__n);
+        const auto __data = __ret.word_data();
+        for (const auto &__c : chunks) {
+            const auto __base = size_t(__c.key) << 16;
+            if (__base >= __n) break;
+            const auto __lim = std::min(__CBits, __n - __base);
+            const auto __dst = __data + __base / __WBits;
+            switch (__c.kind) {
+                case ARRAY:
+                    for (const auto __v : __c.vals)
+                        if (__v < __lim) __ret.set(__base + __v);
+                    break;
+                case BITMAP:
+                    __detail::__bitset::do_or_(__dst, __c.bits.data(), __lim);
+                    break;
+                case RUN:
+                    for (size_t i = 0 ; i != __c.vals.size() ; i += 2)
+                        if (__c.vals[i] < __lim)
+                            fill_bits(__dst, __c.vals[i], std::min <size_t> (__c.vals[i + 1], __lim - 1));
+                    break;
+            }
+        }
+        return __ret;
+    }
+
+    /* Expand into a dense bitset just long enough for all values. */
+    dynamic_bitset to_bitset() const {
+        return this->to_bitset(this->empty() ? 0 : size_t(this->max()) + 1);
+    }
+};
+
+
+} // namespace dark
@@ -1,5 +1,13 @@
 #pragma once
 #include "node.h"
+#include <algorithm>
+#include <bit>
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace dark {
 
@@ -45,21 +53,135 @@ struct node {
 
 static_assert(sizeof(node) == 32);
 
+/**
+ * Work done by the tree algorithms on one thread. Counted only when
+ * _DARK_TREE_STATS is defined; otherwise every hook below is empty
+ * and compiles away, and the counters stay zero.
+ */
+struct tree_counters {
+    size_t rotations;   // Single rotations, by insert, erase and join
+    size_t swaps;       // swap_next calls, by erase of a node with 2 children
+    size_t searches;    // Searches down from a node, by lookups and inserts
+    size_t steps;       // Nodes visited by those searches
+    size_t max_steps;   // Longest single search
+
+#ifdef _DARK_TREE_STATS
+    static constexpr bool enabled = true;
+#else
+    static constexpr bool enabled = false;
+#endif
+
+    /* Counters of this thread so far. */
+    static tree_counters snapshot();
+    /* Zero the counters of this thread. */
+    static void reset();
+
+    /* Call __fn(name, value) for each counter, to export them. */
+    template <typename _Fn>
+    void for_each(_Fn &&__fn) const {
+        __fn(std::string_view {"rotations"},    double(rotations));
+        __fn(std::string_view {"swaps"},        double(swaps));
+        __fn(std::string_view {"searches"},     double(searches));
+        __fn(std::string_view {"steps"},        double(steps));
+        __fn(std::string_view {"max_steps"},    double(max_steps));
+        __fn(std::string_view {"mean_steps"},   searches == 0 ? 0.0 : double(steps) / double(searches));
+    }
+};
+
+#ifdef _DARK_TREE_STATS
+inline thread_local tree_counters __counters {};
+#endif
+
+inline tree_counters tree_counters::snapshot() {
+#ifdef _DARK_TREE_STATS
+    return __counters;
+#else
+    return {};
+#endif
+}
+
+inline void tree_counters::reset() {
+#ifdef _DARK_TREE_STATS
+    __counters = {};
+#endif
+}
+
+/* Add to a counter of this thread. */
+inline constexpr void count([[maybe_unused]] size_t tree_counters::*__field) {
+#ifdef _DARK_TREE_STATS
+    if (!std::is_constant_evaluated()) ++(__counters.*__field);
+#endif
+}
+
+/* Steps of one search, counted when it ends. */
+struct search_probe {
+#ifdef _DARK_TREE_STATS
+    size_t steps = 0;
+    void step() { ++steps; }
+    ~search_probe() {
+        __counters.searches += 1;
+        __counters.steps    += steps;
+        __counters.max_steps = std::max(__counters.max_steps, steps);
+    }
+#else
+    constexpr void step() const {}
+#endif
+};
+
+/**
+ * The balancing algorithms below are templates over the node handle
+ * _Ptr: node * here, or any handle whose -> gives the same fields
+ * (parent, child, color, size) and members (is_special, update_parent).
+ * Locals are spelled _Ptr, so a handle may hand out proxies for them.
+ */
+
+/* Size of a possibly empty subtree. */
+template <typename _Ptr>
+inline constexpr size_t size_of(const _Ptr &__node) {
+    return __node == nullptr ? size_t(0) : size_t(__node->size);
+}
+
 template <typename _Tp>
 using value_node = __node::value_node<_Tp, node>;
 
-template <Direction _Dir>
-inline constexpr auto get_most(node *__node) -> node * {
-    while (auto __next = __node->child[_Dir])
+/**
+ * Augmentation hook of the algorithms below. Beside size, a node may
+ * keep an aggregate of its subtree: pull(x) recomputes it from x and its
+ * children, and clear(x) makes x count as empty (for erase phantoms).
+ * Every link change calls these bottom up. size_only keeps nothing
+ * else, so all its calls compile away.
+ */
+struct size_only {
+    template <typename _Ptr>
+    static constexpr void pull(const _Ptr &) {}
+    template <typename _Ptr>
+    static constexpr void clear(const _Ptr &) {}
+};
+
+/* Key of a set element: the element itself. */
+struct key_self {
+    template <typename _Tp>
+    constexpr const _Tp &operator()(const _Tp &__val) const { return __val; }
+};
+
+/* Key of a map element: its first member. */
+struct key_first {
+    template <typename _Tp>
+    constexpr const auto &operator()(const _Tp &__val) const { return __val.first; }
+};
+
+template <Direction _Dir, typename _Ptr>
+inline constexpr auto get_most(_Ptr __node) -> _Ptr {
+    for (_Ptr __next ; (__next = __node->child[_Dir]) != nullptr ;)
         __node = __next;
     return __node;
 }
 
-template <Direction _Dir>
-inline constexpr auto advance(node *__node) -> node * {
-    if (auto __next = __node->child[_Dir])
+template <Direction _Dir, typename _Ptr>
+inline constexpr auto advance(_Ptr __node) -> _Ptr {
+    if (_Ptr __next = __node->child[_Dir] ; __next != nullptr)
         return get_most <!_Dir> (__next);
-    while (auto __head = __node->parent) {
+    for (_Ptr __head ; (__head = __node->parent) != nullptr ;) {
         if (__head->child[_Dir] != __node) {
             /**
              * There are 2 special cases:
@@ -92,17 +214,27 @@ swap_info(node *__restrict __node, node *__restrict __next) {
     }
 }
 
-inline constexpr auto
-swap_parent(node *__restrict __node, node *__restrict __next) -> node * {
-    auto __head = __node->update_parent(__next);
-    auto __temp = __next->parent;
+template <typename _Ptr>
+inline constexpr void swap_info(_Ptr __node, _Ptr __next) {
+    const Color    __color = __next->color;
+    const unsigned __size  = __next->size;
+    __next->color = __node->color;
+    __next->size  = __node->size;
+    __node->color = __color;
+    __node->size  = __size;
+}
+
+template <typename _Ptr>
+inline constexpr auto swap_parent(_Ptr __node, _Ptr __next) -> _Ptr {
+    _Ptr __head = __node->update_parent(__next);
+    _Ptr __temp = __next->parent;
     __next->parent = __head;
     return __temp;
 }
 
-inline constexpr void
-swap_left(node *__restrict __node, node *__restrict __next) {
-    auto __left = __node->child[LT];
+template <typename _Ptr>
+inline constexpr void swap_left(_Ptr __node, _Ptr __next) {
+    _Ptr __left = __node->child[LT];
     __left->parent    = __next;
     __next->child[LT] = __left;
     __node->child[LT] = nullptr;
@@ -114,8 +246,8 @@ swap_left(node *__restrict __node, node *__restrict __next) {
  * __next->parent    == __node  &&
  * __next->child[LT] == nullptr
  */
-inline constexpr void
-swap_next_adjacent(node *__node, node *__next) {
+template <typename _Ptr>
+inline constexpr void swap_next_adjacent(_Ptr __node, _Ptr __next) {
     swap_info(__node, __next);
 
     /* Swap parent information */
@@ -126,8 +258,9 @@ swap_next_adjacent(node *__node, node *__next) {
     swap_left(__node, __next);
 
     /* Swap right information */
-    __node->child[RT] = __next->child[RT];
-    if (auto __succ = __next->child[RT])
+    _Ptr __succ = __next->child[RT];
+    __node->child[RT] = __succ;
+    if (__succ != nullptr)
         __succ->parent = __node;
     __next->child[RT] = __node;
 }
@@ -138,12 +271,12 @@ swap_next_adjacent(node *__node, node *__next) {
  * __next == __next->parent->child[LT]  &&
  * __next->child[LT] == nullptr
  */
-inline constexpr void
-swap_next_distant(node *__restrict __node, node * __restrict __next) {
+template <typename _Ptr>
+inline constexpr void swap_next_distant(_Ptr __node, _Ptr __next) {
     swap_info(__node, __next);
 
     /* Swap parent information */
-    auto __head = swap_parent(__node, __next);
+    _Ptr __head = swap_parent(__node, __next);
     __node->parent = __head;
     __head->child[LT] = __node; // Must be left son.
 
@@ -151,8 +284,8 @@ swap_next_distant(node *__restrict __node, node * __restrict __next) {
     swap_left(__node, __next);
 
     /* Swap right information */
-    auto __node_right = __node->child[RT];
-    auto __next_right = __next->child[RT];
+    _Ptr __node_right = __node->child[RT];
+    _Ptr __next_right = __next->child[RT];
 
     __next->child[RT] = __node_right;
     __node->child[RT] = __next_right;
@@ -166,12 +299,14 @@ swap_next_distant(node *__restrict __node, node * __restrict __next) {
 }
 
 /* Find the successor and swap with it. */
-inline constexpr void swap_next(node *__restrict __node) {
-    auto __temp = __node->child[RT];
+template <typename _Ptr>
+inline constexpr void swap_next(_Ptr __node) {
+    count(&tree_counters::swaps);
+    _Ptr __temp = __node->child[RT];
     if (__temp->child[LT] == nullptr)
         return swap_next_adjacent(__node, __temp);
 
-    auto __next = get_most <LT> (__temp->child[LT]);
+    _Ptr __next = get_most <LT> (_Ptr(__temp->child[LT]));
     return swap_next_distant(__node, __next);
 }
 
@@ -180,22 +315,655 @@ inline constexpr void swap_next(node *__restrict __node) {
  * __x != root &&
  * __x->parent->child[__dir] == __x
  */
-inline constexpr void rotate(node *__x, Direction __dir) {
-    auto *__p = __x->parent;        // Parent.
-    auto &__a = __p->child[__dir];  // This side. (old = __x)
-    auto &__b = __x->child[!__dir]; // Opposite side.
+template <typename _Aug = size_only, typename _Ptr>
+inline constexpr void rotate(_Ptr __x, Direction __dir) {
+    _Ptr __p = __x->parent;         // Parent.
+    _Ptr __b = __x->child[!__dir];  // Opposite side's son.
 
     /* Relink the opposite side's son to old parent. */
-    __a = __b;
-    __b = __p;
-    if (__a != nullptr) __a->parent = __p;
+    __p->child[__dir]  = __b;
+    __x->child[!__dir] = __p;
+    if (__b != nullptr) __b->parent = __p;
 
     /* Update parent related information. */
     __x->parent = __p->update_parent(__x);
     __p->parent = __x;
+
+    /* Update subtree sizes: __x takes over the whole subtree. */
+    __x->size = __p->size;
+    __p->size = 1 + size_of(_Ptr(__p->child[LT])) + size_of(_Ptr(__p->child[RT]));
+    _Aug::pull(__p);
+    _Aug::pull(__x);
+    count(&tree_counters::rotations);
+}
+
+/**
+ * @note
+ * __node != root
+ * Side of __node under its parent.
+ */
+template <typename _Ptr>
+inline constexpr auto dir_of(_Ptr __node) -> Direction {
+    _Ptr __p = __node->parent;
+    return static_cast <Direction> (__p->child[RT] == __node);
 }
 
+/* Return whether the node is red (WHITE). Null leaves are black. */
+template <typename _Ptr>
+inline constexpr bool is_white(const _Ptr &__node) {
+    return __node != nullptr && __node->color == WHITE;
+}
+
+/**
+ * Red-black rebalance after linking __x as a new red leaf.
+ * Subtree sizes (and aggregates) must already count __x.
+ * Return whether the black height of the tree grew.
+ */
+template <typename _Aug = size_only, typename _Ptr>
+inline constexpr bool insert_fixup(_Ptr __x) {
+    while (!__x->is_special()) {
+        _Ptr __p = __x->parent;
+        if (__p->color == BLACK) return false;
+
+        /* __p is red, so it is not root, and __g is a real node. */
+        _Ptr __g = __p->parent;
+        const auto __pd = dir_of(__p);
+        _Ptr __u = __g->child[!__pd];
+        if (is_white(__u)) { // Recolor and go up.
+            __p->color = __u->color = BLACK;
+            __g->color = WHITE;
+            __x = __g;
+            continue;
+        }
+
+        if (dir_of(__x) != __pd) { // Zig-zag: make it zig-zig.
+            rotate <_Aug> (__x, !__pd);
+            __p = __x;
+        }
+        rotate <_Aug> (__p, __pd);
+        __p->color = BLACK;
+        __g->color = WHITE;
+        return false;
+    }
+    __x->color = BLACK; // Root is always black, and __x was red.
+    return true;
+}
+
+/**
+ * Red-black rebalance before unlinking __x, a black leaf.
+ * __x stays in place as a phantom: its size must be 0 (and it must
+ * be cleared), and its ancestors must no longer count it, so rotations
+ * keep sizes right.
+ */
+template <typename _Aug = size_only, typename _Ptr>
+inline constexpr void erase_fixup(_Ptr __x) {
+    while (!__x->is_special() && __x->color == BLACK) {
+        _Ptr __p = __x->parent;
+        const auto __d = dir_of(__x);
+        _Ptr __s = __p->child[!__d]; // Never null: __x is black.
+        if (__s->color == WHITE) {
+            rotate <_Aug> (__s, !__d);
+            __s->color = BLACK;
+            __p->color = WHITE;
+            __s = __p->child[!__d];
+        }
+
+        _Ptr __far  = __s->child[!__d];
+        _Ptr __near = __s->child[__d];
+        if (!is_white(__far) && !is_white(__near)) {
+            __s->color = WHITE;
+            __x = __p;
+            continue;
+        }
+
+        if (!is_white(__far)) { // Near is red: bring it to the far side.
+            rotate <_Aug> (__near, __d);
+            __near->color = BLACK;
+            __s->color = WHITE;
+            __far = __s;
+            __s = __near;
+        }
+        rotate <_Aug> (__s, !__d);
+        __s->color = __p->color;
+        __p->color = BLACK;
+        __far->color = BLACK;
+        return;
+    }
+    __x->color = BLACK;
+}
+
+/**
+ * Link __node as the __dir child of __parent (or as root if __parent
+ * is __header), then rebalance. __header keeps the leftmost node in
+ * child[LT] and the rightmost node in child[RT].
+ */
+template <typename _Aug = size_only, typename _Ptr>
+inline constexpr void insert_at(_Ptr __header, std::type_identity_t <_Ptr> __parent,
+                                Direction __dir, std::type_identity_t <_Ptr> __node) {
+    __node->color  = WHITE;
+    __node->size   = 1;
+    __node->parent = __parent;
+    __node->child[LT] = __node->child[RT] = nullptr;
+    _Aug::pull(__node);
+
+    if (__parent == __header) {
+        __header->parent = __node;
+        __header->child[LT] = __header->child[RT] = __node;
+    } else {
+        __parent->child[__dir] = __node;
+        if (__header->child[__dir] == __parent)
+            __header->child[__dir] = __node;
+        for (_Ptr __cur = __parent ; __cur != __header ; __cur = __cur->parent) {
+            ++__cur->size;
+            _Aug::pull(__cur);
+        }
+    }
+    insert_fixup <_Aug> (__node);
+}
+
+/* Unlink __node from the tree and rebalance. The node is not freed. */
+template <typename _Aug = size_only, typename _Ptr>
+inline constexpr void erase_at(_Ptr __header, std::type_identity_t <_Ptr> __node) {
+    if (__header->child[LT] == __node || __header->child[RT] == __node) {
+        _Ptr __next = advance <RT> (__node);
+        _Ptr __prev = advance <LT> (__node);
+        if (__header->child[LT] == __node) __header->child[LT] = __next;
+        if (__header->child[RT] == __node) __header->child[RT] = __prev;
+    }
+
+    /* Now __node has at most one child, and it is red if any. */
+    if (__node->child[LT] != nullptr && __node->child[RT] != nullptr)
+        swap_next(__node);
+
+    /* A red son takes the place at once; a leaf stays until the fixup is done. */
+    _Ptr __son = __node->child[__node->child[LT] == nullptr];
+    if (__son != nullptr) {
+        __son->color  = BLACK;
+        __son->parent = __node->parent;
+        __node->update_parent(__son);
+    }
+
+    _Aug::clear(__node);
+    for (_Ptr __cur = __node->parent ; __cur != __header ; __cur = __cur->parent) {
+        --__cur->size;
+        _Aug::pull(__cur);
+    }
+
+    if (__son == nullptr) {
+        if (__node->color == BLACK) {
+            __node->size = 0;
+            erase_fixup <_Aug> (__node);
+        }
+        __node->update_parent(__son);
+    }
+}
+
+/* The __k-th (0-indexed) node in order, __k < size_of(__root). */
+template <typename _Ptr>
+inline constexpr auto select(_Ptr __root, size_t __k) -> _Ptr {
+    for (;;) {
+        const auto __left = size_of(_Ptr(__root->child[LT]));
+        if (__k == __left) return __root;
+        if (__k < __left) {
+            __root = __root->child[LT];
+        } else {
+            __k -= __left + 1;
+            __root = __root->child[RT];
+        }
+    }
+}
+
+/* Number of nodes before __node in order. __node must not be header. */
+template <typename _Ptr>
+inline constexpr size_t index_of(_Ptr __node) {
+    auto __ret = size_of(_Ptr(__node->child[LT]));
+    for (; !__node->is_special() ; __node = __node->parent) {
+        _Ptr __p = __node->parent;
+        if (__p->child[RT] == __node)
+            __ret += size_of(_Ptr(__p->child[LT])) + 1;
+    }
+    return __ret;
+}
+
+/* Black nodes on any path from __node down to a leaf. */
+inline constexpr size_t black_height(const node *__node) {
+    size_t __ret = 0;
+    for (; __node != nullptr ; __node = __node->child[LT])
+        __ret += __node->color == BLACK;
+    return __ret;
+}
+
+/* Make __root (maybe null) the root under __header. Extremes are not set. */
+inline constexpr void adopt(node *__header, node *__root) {
+    __header->parent = __root;
+    if (__root != nullptr) __root->parent = __header;
+}
+
+/* Point the extremes of __header at the leftmost and rightmost nodes. */
+inline constexpr void reset_extremes(node *__header) {
+    if (auto *__root = __header->parent) {
+        __header->child[LT] = get_most <LT> (__root);
+        __header->child[RT] = get_most <RT> (__root);
+    } else {
+        __header->child[LT] = __header->child[RT] = __header;
+    }
+}
+
+/* Link __n nodes in order below __parent. Nodes at depth __red are red. */
+template <typename _Aug = size_only>
+inline constexpr auto build_range(node *const *__nodes, size_t __n,
+                                  node *__parent, size_t __depth, size_t __red) -> node * {
+    if (__n == 0) return nullptr;
+    const auto __mid = __n / 2;
+    auto *__node = __nodes[__mid];
+    __node->color  = __depth == __red ? WHITE : BLACK;
+    __node->size   = __n;
+    __node->parent = __parent;
+    __node->child[LT] = build_range <_Aug> (__nodes, __mid, __node, __depth + 1, __red);
+    __node->child[RT] = build_range <_Aug> (__nodes + __mid + 1, __n - __mid - 1, __node, __depth + 1, __red);
+    _Aug::pull(__node);
+    return __node;
+}
+
+/**
+ * Link __n nodes, given in order, into a tree under the empty __header,
+ * in O(n) and with no rotation. Halving gives a tree whose leaves are
+ * all at the last two levels, so making the deepest level red (unless
+ * it is the root) gives equal black heights.
+ */
+template <typename _Aug = size_only>
+inline constexpr void build(node *__header, node *const *__nodes, size_t __n) {
+    const auto __deepest = std::bit_width(__n) - 1; // For __n != 0.
+    adopt(__header, build_range <_Aug> (__nodes, __n, __header, 0, __deepest == 0 ? size_t(-1) : __deepest));
+    reset_extremes(__header);
+}
+
+/**
+ * Join the trees under __hl and __hr, with __mid in between: all of
+ * __hl < __mid < all of __hr. __bl and __br are their black heights.
+ * __mid is hung on the spine of the taller tree, at the first black
+ * node as high as the shorter one, then fixed as a red insert. The
+ * cost is O(|__bl - __br| + 1). The result is left under __hl and
+ * __hr is emptied; extremes are not set. Return the black height.
+ */
+template <typename _Aug = size_only>
+inline constexpr size_t
+join(node *__hl, size_t __bl, node *__mid, node *__hr, size_t __br) {
+    auto *__lr = __hl->parent;
+    auto *__rr = __hr->parent;
+    if (is_white(__lr)) { __lr->color = BLACK; ++__bl; }
+    if (is_white(__rr)) { __rr->color = BLACK; ++__br; }
+
+    /* Descend the spine of the taller tree, facing the shorter one. */
+    const auto __d  = static_cast <Direction> (__bl >= __br);
+    auto *__tall    = __d == RT ? __hl : __hr;
+    auto *__short   = __d == RT ? __rr : __lr;
+    const auto __lo = __d == RT ? __br : __bl;
+    auto __h        = __d == RT ? __bl : __br;
+
+    node *__p = __tall;
+    node *__c = __tall->parent;
+    while (__h != __lo || is_white(__c)) {
+        __h -= __c->color == BLACK;
+        __p  = __c;
+        __c  = __c->child[__d];
+    }
+
+    __mid->color  = WHITE;
+    __mid->parent = __p;
+    __mid->child[!__d] = __c;
+    __mid->child[__d]  = __short;
+    if (__c != nullptr)     __c->parent = __mid;
+    if (__short != nullptr) __short->parent = __mid;
+    __mid->size = 1 + size_of(__c) + size_of(__short);
+    _Aug::pull(__mid);
+
+    if (__p == __tall) {
+        __tall->parent = __mid;
+    } else {
+        __p->child[__d] = __mid;
+        for (auto *__cur = __p ; __cur != __tall ; __cur = __cur->parent) {
+            __cur->size += size_of(__short) + 1;
+            _Aug::pull(__cur);
+        }
+    }
+
+    const auto __grew = insert_fixup <_Aug> (__mid);
+    adopt(__hl, __tall->parent);
+    __hr->parent = nullptr;
+    return std::max(__bl, __br) + __grew;
+}
+
+/**
+ * Split the tree under __header by a predicate which is false, then
+ * true, in order. Nodes where it is true move under __rhs (an empty
+ * header), the others stay. Pieces hanging off the search path are
+ * joined bottom up, and black heights are tracked along the path, so
+ * the costs telescope to O(log n) in total.
+ */
+template <typename _Aug = size_only, typename _Pred>
+inline constexpr void split(node *__header, node *__rhs, _Pred &&__is_right) {
+    /* Height is at most 2 log2(n + 1), with n < 2^32. */
+    node *      __path[64 * 2 + 2];
+    size_t      __high[64 * 2 + 2]; // Black height of each path node
+    bool        __side[64 * 2 + 2]; // Whether the node goes right
+    size_t      __len = 0;
+
+    size_t __h = black_height(__header->parent);
+    for (auto *__cur = __header->parent ; __cur != nullptr ; ++__len) {
+        __path[__len] = __cur;
+        __high[__len] = __h;
+        __side[__len] = __is_right(__cur);
+        __h  -= __cur->color == BLACK;
+        __cur = __cur->child[__side[__len] ? LT : RT];
+    }
+
+    node __lhs {}, __piece {}; // Headers for the left result and each piece.
+    size_t __bl = 0, __br = 0;
+    while (__len-- != 0) {
+        auto *__node = __path[__len];
+        const auto __bc = __high[__len] - (__node->color == BLACK);
+        if (__side[__len]) { // Node and its right subtree go right.
+            adopt(&__piece, __node->child[RT]);
+            __br = join <_Aug> (__rhs, __br, __node, &__piece, __bc);
+        } else {             // Left subtree and node stay left.
+            adopt(&__piece, __node->child[LT]);
+            __bl = join <_Aug> (&__piece, __bc, __node, &__lhs, __bl);
+            adopt(&__lhs, __piece.parent);
+        }
+    }
+    adopt(__header, __lhs.parent);
+    reset_extremes(__header);
+    reset_extremes(__rhs);
+}
+
+/**
+ * Shape of one tree: how deep its nodes sit, and how they spread in
+ * memory. Depth costs compares; spread costs cache and TLB misses when
+ * nodes are scattered by the allocator.
+ */
+struct tree_shape {
+    size_t size;            // Number of nodes
+    size_t black_height;    // Black nodes on a root to leaf path
+    size_t max_depth;       // Depth of the deepest node, root at 0
+    double mean_depth;      // Mean depth of a node
+    std::vector <size_t> depths; // Nodes at each depth
+    size_t span;            // Bytes from the lowest node to the end of the highest
+    size_t pages;           // Distinct 4 KiB pages holding a node
+    double mean_gap;        // Mean address distance of neighbors in order
+
+    /* Call __fn(name, value) for each number, to export them. */
+    template <typename _Fn>
+    void for_each(_Fn &&__fn) const {
+        __fn(std::string_view {"size"},         double(size));
+        __fn(std::string_view {"black_height"}, double(black_height));
+        __fn(std::string_view {"max_depth"},    double(max_depth));
+        __fn(std::string_view {"mean_depth"},   mean_depth);
+        __fn(std::string_view {"span"},         double(span));
+        __fn(std::string_view {"pages"},        double(pages));
+        __fn(std::string_view {"mean_gap"},     mean_gap);
+        for (size_t i = 0 ; i != depths.size() ; ++i)
+            __fn(std::string_view {"depth." + std::to_string(i)}, double(depths[i]));
+    }
+};
+
+/* Shape of the tree at __root, whose nodes take __bytes each. O(n log n). */
+inline tree_shape shape_of(const node *__root, size_t __bytes) {
+    tree_shape __ret {};
+    __ret.black_height = black_height(__root);
+
+    std::vector <uintptr_t> __addr;
+    size_t __total = 0;
+    uintptr_t __gaps = 0;
+    const auto __walk = [&](auto &__self, const node *__x, size_t __depth) -> void {
+        for (; __x != nullptr ; __x = __x->child[RT], ++__depth) {
+            __self(__self, __x->child[LT], __depth + 1);
+            if (__ret.depths.size() <= __depth) __ret.depths.resize(__depth + 1);
+            ++__ret.depths[__depth];
+            __total += __depth;
+            const auto __a = reinterpret_cast <uintptr_t> (__x);
+            if (!__addr.empty()) __gaps += __a > __addr.back() ? __a - __addr.back() : __addr.back() - __a;
+            __addr.push_back(__a);
+        }
+    };
+    __walk(__walk, __root, 0);
+    if (__addr.empty()) return __ret;
+
+    __ret.size       = __addr.size();
+    __ret.max_depth  = __ret.depths.size() - 1;
+    __ret.mean_depth = double(__total) / double(__ret.size);
+    __ret.mean_gap   = __ret.size == 1 ? 0.0 : double(__gaps) / double(__ret.size - 1);
+
+    std::sort(__addr.begin(), __addr.end());
+    __ret.span = __addr.back() + __bytes - __addr.front();
+    for (size_t i = 0 ; i != __addr.size() ; ++i)
+        __ret.pages += i == 0 || (__addr[i] >> 12) != (__addr[i - 1] >> 12);
+    return __ret;
+}
+
+/**
+ * Node of a persistent tree. Versions share subtrees, so there is no
+ * parent link; refs counts the parents and roots holding the node.
+ */
+struct pnode {
+    std::atomic <uint32_t> refs;    // Holders of this node.
+    Color       color;              // Color of the node.
+    unsigned    size;               // Size of the subtree.
+    pnode *     child[2];           // Left and right child.
+};
+
+static_assert(sizeof(pnode) == 32);
+
+/**
+ * Path-copying red-black updates on pnode, after Kahrs' functional
+ * insert and delete. Every pnode * passed in or returned is an owned
+ * reference: the callee consumes it and hands one back. A node whose
+ * only holder is the caller (refs == 1) cannot be seen by any version,
+ * so it is reused in place; any other node is copied before a change.
+ * Old versions thus stay intact, and only the search path is copied.
+ * _Alloc must be stateless: the last holder, on any thread, frees.
+ */
+template <typename _Tp, typename _Alloc>
+struct persist {
+    using _Node_t = __node::value_node <_Tp, pnode>;
+
+    static_assert(std::is_nothrow_copy_constructible_v <_Tp>,
+        "Persistent trees only support nothrow copyable values now.");
+
+    static const _Tp &value(const pnode *__x) { return static_cast <const _Node_t *> (__x)->value; }
+
+    static pnode *retain(pnode *__x) {
+        if (__x != nullptr) __x->refs.fetch_add(1, std::memory_order_relaxed);
+        return __x;
+    }
+
+    static void release(pnode *__x) {
+        while (__x != nullptr && __x->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            release(__x->child[LT]);
+            auto *__next = __x->child[RT];
+            auto *__ptr  = static_cast <_Node_t *> (__x);
+            __ptr->~_Node_t();
+            _Alloc {}.deallocate(__ptr, 1);
+            __x = __next;
+        }
+    }
+
+    /* Set the fields of a private node, taking over __l and __r. */
+    static pnode *link(pnode *__x, Color __c, pnode *__l, pnode *__r) {
+        __x->color = __c;
+        __x->child[LT] = __l;
+        __x->child[RT] = __r;
+        __x->size = 1 + size_of(__l) + size_of(__r);
+        return __x;
+    }
+
+    /* New private node, taking over __l and __r. */
+    template <typename... _Args>
+    static pnode *make(Color __c, pnode *__l, pnode *__r, _Args &&...__args) {
+        auto *__ptr = _Alloc {}.allocate(1);
+        ::new (static_cast <void *> (__ptr)) _Node_t {{}, _Tp(std::forward <_Args> (__args)...)};
+        __ptr->refs.store(1, std::memory_order_relaxed);
+        return link(__ptr, __c, __l, __r);
+    }
+
+    /* Private version of owned __x: itself if unshared, or else a copy. */
+    static pnode *own(pnode *__x) {
+        if (__x->refs.load(std::memory_order_acquire) == 1) return __x;
+        auto *__y = make(__x->color, retain(__x->child[LT]), retain(__x->child[RT]), value(__x));
+        release(__x);
+        return __y;
+    }
+
+    static pnode *recolor(pnode *__x, Color __c) {
+        __x = own(__x);
+        __x->color = __c;
+        return __x;
+    }
+
+    /* Black __x over __l and __r, fixing a red-red pair below it. */
+    static pnode *balance(pnode *__l, pnode *__x, pnode *__r) {
+        if (is_white(__l) && is_white(__r))
+            return link(__x, WHITE, recolor(__l, BLACK), recolor(__r, BLACK));
+        if (is_white(__l)) {
+            if (is_white(__l->child[LT])) {
+                __l = own(__l);
+                auto *__a = __l->child[LT], *__b = __l->child[RT];
+                return link(__l, WHITE, recolor(__a, BLACK), link(__x, BLACK, __b, __r));
+            }
+            if (is_white(__l->child[RT])) {
+                __l = own(__l);
+                auto *__m = own(__l->child[RT]);
+                auto *__a = __l->child[LT], *__b = __m->child[LT], *__c = __m->child[RT];
+                return link(__m, WHITE, link(__l, BLACK, __a, __b), link(__x, BLACK, __c, __r));
+            }
+        }
+        if (is_white(__r)) {
+            if (is_white(__r->child[RT])) {
+                __r = own(__r);
+                auto *__b = __r->child[LT], *__c = __r->child[RT];
+                return link(__r, WHITE, link(__x, BLACK, __l, __b), recolor(__c, BLACK));
+            }
+            if (is_white(__r->child[LT])) {
+                __r = own(__r);
+                auto *__m = own(__r->child[LT]);
+                auto *__b = __m->child[LT], *__c = __m->child[RT], *__d = __r->child[RT];
+                return link(__m, WHITE, link(__x, BLACK, __l, __b), link(__r, BLACK, __c, __d));
+            }
+        }
+        return link(__x, BLACK, __l, __r);
+    }
+
+    /* __x over __l and __r, where __l is one black level short. */
+    static pnode *balance_left(pnode *__l, pnode *__x, pnode *__r) {
+        if (is_white(__l))
+            return link(__x, WHITE, recolor(__l, BLACK), __r);
+        if (__r->color == BLACK)
+            return balance(__l, __x, recolor(__r, WHITE));
+        __r = own(__r);
+        auto *__m = own(__r->child[LT]);
+        auto *__a = __m->child[LT], *__b = __m->child[RT], *__c = __r->child[RT];
+        auto *__rhs = balance(__b, __r, recolor(__c, WHITE));
+        return link(__m, WHITE, link(__x, BLACK, __l, __a), __rhs);
+    }
+
+    /* __x over __l and __r, where __r is one black level short. */
+    static pnode *balance_right(pnode *__l, pnode *__x, pnode *__r) {
+        if (is_white(__r))
+            return link(__x, WHITE, __l, recolor(__r, BLACK));
+        if (__l->color == BLACK)
+            return balance(recolor(__l, WHITE), __x, __r);
+        __l = own(__l);
+        auto *__m = own(__l->child[RT]);
+        auto *__a = __l->child[LT], *__b = __m->child[LT], *__c = __m->child[RT];
+        auto *__lhs = balance(recolor(__a, WHITE), __l, __b);
+        return link(__m, WHITE, __lhs, link(__x, BLACK, __c, __r));
+    }
+
+    /* Concatenate __l and __r, of equal black height, all __l < all __r. */
+    static pnode *append(pnode *__l, pnode *__r) {
+        if (__l == nullptr) return __r;
+        if (__r == nullptr) return __l;
+        if (is_white(__l) != is_white(__r)) {
+            if (is_white(__r)) {
+                __r = own(__r);
+                auto *__a = __r->child[LT], *__b = __r->child[RT];
+                return link(__r, WHITE, append(__l, __a), __b);
+            } else {
+                __l = own(__l);
+                auto *__a = __l->child[LT], *__b = __l->child[RT];
+                return link(__l, WHITE, __a, append(__b, __r));
+            }
+        }
+        const auto __c = __l->color;
+        __l = own(__l);
+        __r = own(__r);
+        auto *__a = __l->child[LT], *__d = __r->child[RT];
+        auto *__m = append(__l->child[RT], __r->child[LT]);
+        if (is_white(__m)) {
+            __m = own(__m);
+            auto *__b = __m->child[LT], *__e = __m->child[RT];
+            return link(__m, WHITE, link(__l, __c, __a, __b), link(__r, __c, __e, __d));
+        }
+        if (__c == WHITE)
+            return link(__l, WHITE, __a, link(__r, WHITE, __m, __d));
+        return balance_left(__a, __l, link(__r, BLACK, __m, __d));
+    }
+
+    /**
+     * Insert below owned __t. __where(node) < 0 goes left, > 0 right;
+     * the key must be absent. __args build the new value.
+     */
+    template <typename _Fn, typename... _Args>
+    static pnode *insert(pnode *__t, _Fn &__where, _Args &&...__args) {
+        if (__t == nullptr)
+            return make(WHITE, nullptr, nullptr, std::forward <_Args> (__args)...);
+        __t = own(__t);
+        auto *__l = __t->child[LT], *__r = __t->child[RT];
+        if (__where(__t) < 0) __l = insert(__l, __where, std::forward <_Args> (__args)...);
+        else                  __r = insert(__r, __where, std::forward <_Args> (__args)...);
+        return __t->color == BLACK ? balance(__l, __t, __r) : link(__t, WHITE, __l, __r);
+    }
+
+    /* Erase the node where __where(node) == 0 below owned __t; it must exist. */
+    template <typename _Fn>
+    static pnode *erase(pnode *__t, _Fn &__where) {
+        __t = own(__t);
+        auto *__l = __t->child[LT], *__r = __t->child[RT];
+        const auto __cmp = __where(__t);
+        if (__cmp == 0) {
+            __t->child[LT] = __t->child[RT] = nullptr;
+            release(__t);
+            return append(__l, __r);
+        }
+        if (__cmp < 0) {
+            const bool __short = __l->color == BLACK;
+            __l = erase(__l, __where);
+            return __short ? balance_left(__l, __t, __r) : link(__t, WHITE, __l, __r);
+        } else {
+            const bool __short = __r->color == BLACK;
+            __r = erase(__r, __where);
+            return __short ? balance_right(__l, __t, __r) : link(__t, WHITE, __l, __r);
+        }
+    }
+
+    /* Root operations: the result root is black. */
+    template <typename _Fn, typename... _Args>
+    static pnode *insert_root(pnode *__t, _Fn &&__where, _Args &&...__args) {
+        return recolor(insert(__t, __where, std::forward <_Args> (__args)...), BLACK);
+    }
+    template <typename _Fn>
+    static pnode *erase_root(pnode *__t, _Fn &&__where) {
+        __t = erase(__t, __where);
+        return __t == nullptr ? nullptr : recolor(__t, BLACK);
+    }
+};
+
 } // namespace __detail::__tree
 
 
+/* Tree statistics: see __detail::__tree::tree_counters and tree_shape. */
+using tree_counters = __detail::__tree::tree_counters;
+using tree_shape    = __detail::__tree::tree_shape;
+
+
 } // namespace dark
@@ -0,0 +1,104 @@
+#pragma once
+#include "basic.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+namespace dark {
+
+/**
+ * A fork-join thread pool.
+ * parallel_for() hands out indices to workers and the caller,
+ * and returns when all of them are done.
+ */
+struct thread_pool {
+  private:
+    std::vector <std::thread>   workers;
+    std::mutex                  job;    // Serialize parallel_for calls
+    std::mutex                  mtx;    // Guard state below
+    std::condition_variable     wake;   // Notify workers of a new job
+    std::condition_variable     done;   // Notify caller of finished job
+
+    size_t  epoch = 0;      // Bumped for each job
+    size_t  busy  = 0;      // Workers still in current job
+    bool    stop  = false;  // Whether to shut down
+
+    void  (*call)(void *, size_t) = nullptr;   // Task of current job
+    void *  ctx   = nullptr;                    // Context of the task
+    size_t  total = 0;                          // Number of indices
+    std::atomic <size_t> next {0};              // Next index to run
+
+    /* Run indices until none is left. */
+    void drain() {
+        for (size_t i ; (i = next.fetch_add(1, std::memory_order_relaxed)) < total ;)
+            call(ctx, i);
+    }
+
+    void loop() {
+        size_t __seen = 0;
+        for (;;) {
+            {
+                std::unique_lock __lock {mtx};
+                wake.wait(__lock, [&] { return stop || epoch != __seen; });
+                if (stop) return;
+                __seen = epoch;
+            }
+            this->drain();
+            std::lock_guard __lock {mtx};
+            if (--busy == 0) done.notify_one();
+        }
+    }
+
+  public:
+    /* Create a pool of __n threads in total, including the caller. */
+    explicit thread_pool(size_t __n = std::thread::hardware_concurrency()) {
+        for (size_t i = 1 ; i < __n ; ++i)
+            workers.emplace_back([this] { this->loop(); });
+    }
+
+    thread_pool(const thread_pool &) = delete;
+    thread_pool &operator = (const thread_pool &) = delete;
+
+    ~thread_pool() {
+        {
+            std::lock_guard __lock {mtx};
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto &__t : workers) __t.join();
+    }
+
+    /* Number of threads, including the caller. */
+    size_t size() const { return workers.size() + 1; }
+
+    /* Call __fn(i) for each i in [0, __n). __fn must not throw. */
+    template <typename _Fn>
+    void parallel_for(size_t __n, _Fn &&__fn) {
+        if (workers.empty() || __n <= 1) {
+            for (size_t i = 0 ; i != __n ; ++i) __fn(i);
+            return;
+        }
+
+        std::lock_guard __guard {job};
+        {
+            std::lock_guard __lock {mtx};
+            call  = [](void *__ctx, size_t __i) {
+                (*static_cast <std::remove_reference_t <_Fn> *> (__ctx))(__i);
+            };
+            ctx   = const_cast <void *> (static_cast <const void *> (&__fn));
+            total = __n;
+            next.store(0, std::memory_order_relaxed);
+            busy  = workers.size();
+            ++epoch;
+        }
+        wake.notify_all();
+        this->drain();
+
+        std::unique_lock __lock {mtx};
+        done.wait(__lock, [&] { return busy == 0; });
+    }
+};
+
+} // namespace dark